@@ -9,8 +9,16 @@ layout(binding = 1, std430) readonly buffer PM_Buffer {
     Point_Mass point_masses[];
 };
 
-uniform float max_field;
-uniform int render_mode;
+// Must match Frame_Constants in rendering.cpp.
+layout(std140, binding = 0) uniform Frame {
+    mat4 vp;
+    float max_field;
+    int render_mode;
+    float softening_length;
+    // Softening in gravity.hpp.
+    int softening;
+};
+
 const float isoline_levels = 32;
 
 in vec2 world_position;
@@ -49,14 +57,31 @@ const vec4[32] color_lut = vec4[32](vec4(255.0 / 255.0, 0.0 / 255.0, 0.0 / 255.0
                                     vec4(0.0 / 255.0, 7.0 / 255.0, 33.0 / 255.0, 1.0),
                                     vec4(0.0 / 255.0, 0.0 / 255.0, 0.0 / 255.0, 1.0));
 
+// Same kernels as Plummer_Softening and Spline_Softening in gravity.hpp.
+// Returns f such that the acceleration exerted by a unit mass separated by d is G f d.
+float get_force_factor(float dist_squared) {
+    float h = softening_length;
+    if(softening == 0) {
+        float s = dist_squared + h * h;
+        return inversesqrt(s) / s;
+    }
+
+    float dist = sqrt(dist_squared);
+    float inverse_h3 = 1.0 / (h * h * h);
+    float u = dist / h;
+    float inner = inverse_h3 * (32.0 / 3.0 + u * u * (32.0 * u - 38.4));
+    float um = max(u, 0.5);
+    float middle = inverse_h3 * (64.0 / 3.0 - 48.0 * um + 38.4 * um * um - 32.0 / 3.0 * um * um * um - 1.0 / 15.0 / (um * um * um));
+    float r = max(dist, h);
+    float outer = 1.0 / (r * r * r);
+    return u < 0.5 ? inner : (u < 1.0 ? middle : outer);
+}
+
 void main() {
     vec2 accel = vec2(0, 0);
     for(int i = 0; i < point_masses.length(); ++i) {
         vec2 dist_vec = point_masses[i].position - world_position;
-        float dist = length(dist_vec);
-        float accel_strength = 6.67408E-11 * point_masses[i].mass / dist / dist;
-        vec2 dist_vec_norm = dist_vec / dist;
-        accel += accel_strength * dist_vec_norm;
+        accel += 6.67408E-11 * point_masses[i].mass * get_force_factor(dot(dist_vec, dist_vec)) * dist_vec;
     }
 
     float field_strength = length(accel);
@@ -2,7 +2,15 @@
 
 layout(location = 0) in vec3 position;
 
-uniform mat4 vp;
+// Must match Frame_Constants in rendering.cpp.
+layout(std140, binding = 0) uniform Frame {
+    mat4 vp;
+    float max_field;
+    int render_mode;
+    float softening_length;
+    // Softening in gravity.hpp.
+    int softening;
+};
 
 out vec2 world_position;
 
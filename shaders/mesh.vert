@@ -2,12 +2,22 @@
 
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec4 color;
+// Per instance.
+layout(location = 2) in mat4 model;
 
-uniform mat4 mvp;
+// Must match Frame_Constants in rendering.cpp.
+layout(std140, binding = 0) uniform Frame {
+    mat4 vp;
+    float max_field;
+    int render_mode;
+    float softening_length;
+    // Softening in gravity.hpp.
+    int softening;
+};
 
 layout(location = 0) out vec4 out_color;
 
 void main() {
     out_color = color;
-    gl_Position = mvp * vec4(position, 1.0);
+    gl_Position = vp * model * vec4(position, 1.0);
 }
@@ -0,0 +1,14 @@
+#version 450 core
+
+layout(location = 0) in vec4 in_color;
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+    // Round the points.
+    vec2 offset = 2.0 * gl_PointCoord - 1.0;
+    if(dot(offset, offset) > 1.0) {
+        discard;
+    }
+    out_color = in_color;
+}
@@ -0,0 +1,24 @@
+#version 450 core
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 color;
+
+// Must match Frame_Constants in rendering.cpp.
+layout(std140, binding = 0) uniform Frame {
+    mat4 vp;
+    float max_field;
+    int render_mode;
+    float softening_length;
+    // Softening in gravity.hpp.
+    int softening;
+};
+
+uniform float point_size;
+
+layout(location = 0) out vec4 out_color;
+
+void main() {
+    out_color = color;
+    gl_PointSize = point_size;
+    gl_Position = vp * vec4(position, 1.0);
+}
@@ -0,0 +1,152 @@
+#include <allocation_tracking.hpp>
+
+#include <atomic>
+
+#include <stdlib.h>
+
+#if GRAVITY_SIMULATION_ALLOCATION_TRACKING && defined(__GLIBC__)
+    #define ALLOCATION_TRACKING_INTERPOSE 1
+    #include <errno.h>
+#else
+    #define ALLOCATION_TRACKING_INTERPOSE 0
+#endif
+
+// Separate cache lines, since the allocating threads update the counters concurrently.
+struct alignas(64) Allocation_Counter {
+    std::atomic<i64> count = 0;
+    std::atomic<i64> bytes = 0;
+};
+
+// Constant initialized, hence usable by the allocations made before main and during static initialization.
+static Allocation_Counter counters[allocation_tag_count];
+static thread_local Allocation_Tag current_tag = Allocation_Tag::other;
+
+[[maybe_unused]] static void record_allocation(u64 const size) {
+    Allocation_Counter& counter = counters[(i32)current_tag];
+    counter.count.fetch_add(1, std::memory_order_relaxed);
+    counter.bytes.fetch_add((i64)size, std::memory_order_relaxed);
+}
+
+#if ALLOCATION_TRACKING_INTERPOSE
+
+// The implementations of glibc that the interposed functions forward to.
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* memory, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* memory);
+}
+
+extern "C" void* malloc(size_t const size) noexcept {
+    record_allocation(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t const count, size_t const size) noexcept {
+    record_allocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* const memory, size_t const size) noexcept {
+    if(size > 0) {
+        record_allocation(size);
+    }
+    return __libc_realloc(memory, size);
+}
+
+extern "C" void* memalign(size_t const alignment, size_t const size) noexcept {
+    record_allocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" void* aligned_alloc(size_t const alignment, size_t const size) noexcept {
+    record_allocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** const memory, size_t const alignment, size_t const size) noexcept {
+    if(alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+
+    record_allocation(size);
+    void* const result = __libc_memalign(alignment, size);
+    if(!result) {
+        return ENOMEM;
+    }
+
+    *memory = result;
+    return 0;
+}
+
+extern "C" void free(void* const memory) noexcept {
+    __libc_free(memory);
+}
+
+#endif
+
+char const* get_allocation_tag_name(Allocation_Tag const tag) {
+    switch(tag) {
+        case Allocation_Tag::other:
+            return "other";
+        case Allocation_Tag::physics:
+            return "physics";
+        case Allocation_Tag::rendering:
+            return "rendering";
+        case Allocation_Tag::timeline:
+            return "timeline";
+        case Allocation_Tag::trails:
+            return "trails";
+        case Allocation_Tag::query:
+            return "query";
+        case Allocation_Tag::debug_output:
+            return "debug_output";
+        case Allocation_Tag::encoder:
+            return "encoder";
+    }
+    return "unknown";
+}
+
+bool is_allocation_tracking_available() {
+    return ALLOCATION_TRACKING_INTERPOSE;
+}
+
+Allocation_Tag get_allocation_tag() {
+    return current_tag;
+}
+
+Allocation_Snapshot take_allocation_snapshot() {
+    Allocation_Snapshot snapshot;
+    for(i32 i = 0; i < allocation_tag_count; ++i) {
+        snapshot.tags[i].count = counters[i].count.load(std::memory_order_relaxed);
+        snapshot.tags[i].bytes = counters[i].bytes.load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+Allocation_Snapshot get_allocations_between(Allocation_Snapshot const& begin, Allocation_Snapshot const& end) {
+    Allocation_Snapshot difference;
+    for(i32 i = 0; i < allocation_tag_count; ++i) {
+        difference.tags[i].count = end.tags[i].count - begin.tags[i].count;
+        difference.tags[i].bytes = end.tags[i].bytes - begin.tags[i].bytes;
+    }
+    return difference;
+}
+
+Allocation_Counts get_allocation_total(Allocation_Snapshot const& snapshot) {
+    Allocation_Counts total;
+    for(Allocation_Counts const& counts: snapshot.tags) {
+        total.count += counts.count;
+        total.bytes += counts.bytes;
+    }
+    return total;
+}
+
+Allocation_Scope::Allocation_Scope(Allocation_Tag const tag): previous(current_tag) {
+    current_tag = tag;
+}
+
+Allocation_Scope::~Allocation_Scope() {
+    current_tag = previous;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <build.hpp>
+
+// Opt-in accounting of the heap allocations for finding the allocations in the frame loop.
+// When compiled in with GRAVITY_SIMULATION_ALLOCATION_TRACKING, malloc and its relatives are
+// interposed, so the allocations of the anton containers, of format and of the libraries are
+// all seen. Every allocation is counted under the tag of the innermost allocation scope of the
+// allocating thread. The interposition requires glibc, elsewhere nothing is recorded.
+
+enum struct Allocation_Tag : u8 {
+    other,
+    physics,
+    rendering,
+    timeline,
+    trails,
+    query,
+    debug_output,
+    encoder,
+};
+
+constexpr i32 allocation_tag_count = 8;
+
+[[nodiscard]] char const* get_allocation_tag_name(Allocation_Tag tag);
+
+// is_allocation_tracking_available
+// Returns true if the tracking has been compiled in and the platform supports it.
+//
+[[nodiscard]] bool is_allocation_tracking_available();
+
+// get_allocation_tag
+// Returns the tag of the innermost allocation scope of the calling thread.
+//
+[[nodiscard]] Allocation_Tag get_allocation_tag();
+
+struct Allocation_Counts {
+    i64 count = 0;
+    i64 bytes = 0;
+};
+
+struct Allocation_Snapshot {
+    Allocation_Counts tags[allocation_tag_count];
+};
+
+// take_allocation_snapshot
+// Returns the number of allocations and the allocated bytes of every tag since the start of the program.
+//
+[[nodiscard]] Allocation_Snapshot take_allocation_snapshot();
+
+// get_allocations_between
+// Returns the allocations made between the two snapshots.
+//
+[[nodiscard]] Allocation_Snapshot get_allocations_between(Allocation_Snapshot const& begin, Allocation_Snapshot const& end);
+
+// get_allocation_total
+// Returns the sum of all tags of the snapshot.
+//
+[[nodiscard]] Allocation_Counts get_allocation_total(Allocation_Snapshot const& snapshot);
+
+struct Allocation_Scope {
+public:
+    Allocation_Scope(Allocation_Tag tag);
+    Allocation_Scope(Allocation_Scope const&) = delete;
+    Allocation_Scope& operator=(Allocation_Scope const&) = delete;
+    ~Allocation_Scope();
+
+private:
+    Allocation_Tag previous;
+};
+
+#define ALLOCATION_CONCAT_IMPL(a, b) a##b
+#define ALLOCATION_CONCAT(a, b) ALLOCATION_CONCAT_IMPL(a, b)
+
+#if GRAVITY_SIMULATION_ALLOCATION_TRACKING
+    #define ALLOCATION_SCOPE(tag) Allocation_Scope const ALLOCATION_CONCAT(allocation_scope_, __LINE__){tag}
+#else
+    #define ALLOCATION_SCOPE(tag)
+#endif
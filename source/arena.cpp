@@ -0,0 +1,89 @@
+#include <arena.hpp>
+
+// Blocks store their header at the beginning of the allocation.
+// Also the alignment of the blocks.
+constexpr i64 block_header_size = 64;
+
+Arena_Allocator::Arena_Allocator(i64 const block_size): block_size(block_size) {}
+
+Arena_Allocator::~Arena_Allocator() {
+    free_blocks();
+}
+
+void Arena_Allocator::allocate_block(i64 const capacity) {
+    void* const memory = upstream.allocate(block_header_size + capacity, block_header_size);
+    Block* const block = (Block*)memory;
+    block->previous = current;
+    block->capacity = capacity;
+    block->used = 0;
+    if(current) {
+        used_in_previous_blocks += current->used;
+    }
+    current = block;
+    upstream_allocation_count += 1;
+}
+
+void Arena_Allocator::free_blocks() {
+    while(current) {
+        Block* const previous = current->previous;
+        upstream.deallocate(current, block_header_size + current->capacity, block_header_size);
+        current = previous;
+    }
+    used_in_previous_blocks = 0;
+}
+
+void* Arena_Allocator::allocate(i64 const size, i64 const alignment) {
+    auto allocate_from_current = [this, size, alignment]() -> void* {
+        u64 const data = (u64)current + block_header_size;
+        u64 const address = (data + current->used + alignment - 1) & ~(u64)(alignment - 1);
+        i64 const end = (i64)(address - data) + size;
+        if(end > current->capacity) {
+            return nullptr;
+        }
+
+        current->used = end;
+        high_water_mark = math::max(high_water_mark, used_in_previous_blocks + end);
+        return (void*)address;
+    };
+
+    if(current) {
+        if(void* const memory = allocate_from_current()) {
+            return memory;
+        }
+    }
+
+    allocate_block(math::max(block_size, size + alignment));
+    return allocate_from_current();
+}
+
+void Arena_Allocator::deallocate(void*, i64, i64) {
+    // Memory is released by reset.
+}
+
+bool Arena_Allocator::is_equal(Memory_Allocator const& other) const {
+    return this == &other;
+}
+
+void Arena_Allocator::reset() {
+    if(!current) {
+        return;
+    }
+
+    if(current->previous) {
+        // Coalesce into a single block that fits everything that has been used so far
+        // with some slack for the alignment padding.
+        i64 const capacity = math::max(high_water_mark + high_water_mark / 8, block_size);
+        free_blocks();
+        allocate_block(capacity);
+    } else {
+        current->used = 0;
+    }
+}
+
+i64 Arena_Allocator::get_high_water_mark() const {
+    return high_water_mark;
+}
+
+i64 Arena_Allocator::get_upstream_allocation_count() const {
+    return upstream_allocation_count;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <anton/allocator.hpp>
+#include <anton/array.hpp>
+#include <build.hpp>
+
+// Arena_Allocator
+// Bump allocator for memory that lives until the end of a step or a frame.
+// deallocate is a no-op, all memory is released at once by reset. When a step needs more
+// than a single block, reset coalesces the blocks into one large enough block so that
+// the following steps of the same size do not allocate from the upstream allocator at all.
+//
+struct Arena_Allocator: public Memory_Allocator {
+public:
+    explicit Arena_Allocator(i64 block_size = 65536);
+    Arena_Allocator(Arena_Allocator const&) = delete;
+    Arena_Allocator& operator=(Arena_Allocator const&) = delete;
+    ~Arena_Allocator() override;
+
+    [[nodiscard]] void* allocate(i64 size, i64 alignment) override;
+    void deallocate(void* memory, i64 size, i64 alignment) override;
+    [[nodiscard]] bool is_equal(Memory_Allocator const& other) const override;
+
+    // reset
+    // Invalidates all allocations made since the previous reset.
+    //
+    void reset();
+
+    // get_high_water_mark
+    // Largest number of bytes in use between two resets since the creation of the arena.
+    //
+    [[nodiscard]] i64 get_high_water_mark() const;
+
+    // get_upstream_allocation_count
+    // Number of blocks that have been allocated from the upstream allocator.
+    //
+    [[nodiscard]] i64 get_upstream_allocation_count() const;
+
+private:
+    struct Block {
+        Block* previous;
+        i64 capacity;
+        i64 used;
+    };
+
+    Allocator upstream;
+    Block* current = nullptr;
+    i64 block_size;
+    // Sum of the used bytes of all blocks preceding current.
+    i64 used_in_previous_blocks = 0;
+    i64 high_water_mark = 0;
+    i64 upstream_allocation_count = 0;
+
+    void allocate_block(i64 capacity);
+    void free_blocks();
+};
+
+// Arena_Array
+// Array whose memory comes from an arena. Construct with Polymorphic_Allocator{&arena}.
+// Must be destroyed before the arena is reset.
+//
+template<typename T>
+using Arena_Array = Array<T, Polymorphic_Allocator>;
@@ -0,0 +1,71 @@
+#include <determinism.hpp>
+
+#include <anton/console.hpp>
+#include <anton/format.hpp>
+#include <generators.hpp>
+#include <physics.hpp>
+#include <point_mass.hpp>
+#include <scene.hpp>
+#include <transform.hpp>
+#include <world.hpp>
+
+constexpr i32 thread_counts[] = {1, 2, 8, 32};
+// Each frame runs 4 substeps.
+constexpr i64 frame_count = 4;
+
+struct Generated_Scene {
+    Generator_Kind kind;
+    i64 count;
+};
+
+constexpr Generated_Scene generated_scenes[] = {{Generator_Kind::uniform_disk, 1000}, {Generator_Kind::kuzmin_disk, 2000}, {Generator_Kind::plummer, 4000}};
+
+template<typename Load_Scene>
+static bool check_scene(String_View const name, Load_Scene const& load_scene) {
+    Console_Output cout;
+    u64 reference_hash = 0;
+    bool matches = true;
+    for(i32 const thread_count: thread_counts) {
+        World world;
+        world.register_type<Point_Mass>();
+        world.register_type<Transform>();
+        load_scene(world);
+
+        Physics_Settings settings;
+        settings.thread_count = thread_count;
+        settings.deterministic = true;
+        Physics_World* const physics_world = create_physics_world(settings);
+        for(i64 frame = 0; frame < frame_count; ++frame) {
+            run_physics(*physics_world, world, 1.0f / 60.0f);
+        }
+        destory_physics_world(physics_world);
+
+        Slice<Point_Mass> const point_masses = world.components<Point_Mass>();
+        u64 const hash = hash_point_masses(Slice<Point_Mass const>{point_masses.begin(), point_masses.end()});
+        if(thread_count == thread_counts[0]) {
+            reference_hash = hash;
+        }
+
+        bool const match = hash == reference_hash;
+        matches = matches && match;
+        cout.write(format(u8"{} threads={} hash={} {}\n", name, thread_count, hash, match ? u8"ok" : u8"MISMATCH"));
+    }
+    return matches;
+}
+
+bool check_determinism(Slice<String const> const scene_paths) {
+    bool matches = true;
+    for(String const& path: scene_paths) {
+        matches &= check_scene(path, [&path](World& world) { load_scene_from_file(world, path); });
+    }
+
+    for(Generated_Scene const& scene: generated_scenes) {
+        String const name = format(u8"generated_{}_{}", (i32)scene.kind, scene.count);
+        Generator_Settings settings;
+        settings.kind = scene.kind;
+        settings.count = scene.count;
+        settings.seed = 0x5EED;
+        matches &= check_scene(name, [&settings](World& world) { generate_scene(world, settings); });
+    }
+    return matches;
+}
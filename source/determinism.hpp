@@ -0,0 +1,15 @@
+#pragma once
+
+#include <anton/slice.hpp>
+#include <anton/string.hpp>
+#include <build.hpp>
+
+// check_determinism
+// Steps every scene file and a set of generated scenes in the deterministic mode with
+// 1, 2, 8 and 32 threads and compares the hashes of the resulting states.
+// Prints a report for every scene.
+//
+// Returns:
+// true if all thread counts produced identical states for every scene.
+//
+[[nodiscard]] bool check_determinism(Slice<String const> scene_paths);
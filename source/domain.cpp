@@ -0,0 +1,586 @@
+#include <domain.hpp>
+
+#if defined(__linux__)
+
+#    include <anton/array.hpp>
+#    include <anton/assert.hpp>
+#    include <gravity.hpp>
+#    include <point_mass.hpp>
+#    include <quadtree.hpp>
+#    include <trace.hpp>
+
+#    include <algorithm>
+#    include <cmath>
+#    include <cstdio>
+#    include <cstdlib>
+#    include <new>
+
+#    include <fcntl.h>
+#    include <pthread.h>
+#    include <sched.h>
+#    include <signal.h>
+#    include <sys/mman.h>
+#    include <sys/prctl.h>
+#    include <sys/wait.h>
+#    include <unistd.h>
+
+constexpr i32 max_domains = 64;
+
+enum struct Domain_Command : i32 {
+    step,
+    quit,
+};
+
+struct Domain_Summary {
+    // Range of the bodies of the domain in the shared state.
+    i64 begin;
+    i64 end;
+    Vec2 box_min;
+    Vec2 box_max;
+    f64 mass;
+    f64 center_x;
+    f64 center_y;
+    // Traceless quadrupole moment about the center of mass.
+    f64 quadrupole_xx;
+    f64 quadrupole_xy;
+    f64 quadrupole_yy;
+};
+
+// Lives at the beginning of the shared mapping and is followed by two buffers
+// of capacity bodies. One holds the state at t, the workers write t+dt to the other.
+struct Shared_Header {
+    // The coordinator and the workers.
+    pthread_barrier_t control_barrier;
+    // The workers only.
+    pthread_barrier_t step_barrier;
+    Physics_Settings settings;
+    Domain_Command command;
+    i64 step_count;
+    i64 body_count;
+    // Index of the buffer holding the current state.
+    i32 current;
+    i32 domain_count;
+    Domain_Summary domains[max_domains];
+};
+
+struct Domain_Decomposition {
+    Physics_Settings settings;
+    i64 capacity;
+    void* mapping;
+    i64 mapping_size;
+    Shared_Header* header;
+    Point_Mass* states[2];
+    Array<pid_t> workers;
+    // Index in the caller's array of every body in the shared state.
+    Array<i64> permutation;
+    Array<i64> permutation_scratch;
+    Array<i64> order;
+    i64 steps_since_rebalance = 0;
+    bool balanced = false;
+};
+
+// Worker scratch memory. Allocated by the worker after pinning so that it is local to its node.
+struct Worker_Scratch {
+    // The bodies of the own domain followed by the bodies of the near domains.
+    Array<Point_Mass> sources;
+    Array<i32> far_domains;
+    Array<Vec2> accelerations;
+    Array<Vec2> positions_next;
+    Quadtree tree;
+};
+
+// Reads a small file from /sys into buffer and null terminates it.
+static bool read_system_file(char const* const path, char* const buffer, i64 const buffer_size) {
+    i32 const file = open(path, O_RDONLY);
+    if(file < 0) {
+        return false;
+    }
+
+    i64 const size = read(file, buffer, buffer_size - 1);
+    close(file);
+    if(size <= 0) {
+        return false;
+    }
+
+    buffer[size] = '\0';
+    return true;
+}
+
+static i32 count_numa_nodes() {
+    i32 count = 0;
+    char path[128];
+    char buffer[16];
+    while(count < max_domains) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", count);
+        if(!read_system_file(path, buffer, sizeof(buffer))) {
+            break;
+        }
+        count += 1;
+    }
+    return count;
+}
+
+// Pins the calling process to the cpus of the node. The cpu list has the format "0-3,8-11".
+static void pin_to_numa_node(i32 const node) {
+    char path[128];
+    char buffer[4096];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    if(!read_system_file(path, buffer, sizeof(buffer))) {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    char* cursor = buffer;
+    while(*cursor >= '0' && *cursor <= '9') {
+        i64 const first = strtol(cursor, &cursor, 10);
+        i64 last = first;
+        if(*cursor == '-') {
+            last = strtol(cursor + 1, &cursor, 10);
+        }
+
+        for(i64 cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu) {
+            CPU_SET(cpu, &set);
+        }
+
+        if(*cursor == ',') {
+            ++cursor;
+        }
+    }
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+static void compute_summary(Domain_Summary& summary, Point_Mass const* const state) {
+    summary.box_min = Vec2{0.0f, 0.0f};
+    summary.box_max = Vec2{0.0f, 0.0f};
+    summary.mass = 0.0;
+    summary.center_x = 0.0;
+    summary.center_y = 0.0;
+    summary.quadrupole_xx = 0.0;
+    summary.quadrupole_xy = 0.0;
+    summary.quadrupole_yy = 0.0;
+    if(summary.begin == summary.end) {
+        return;
+    }
+
+    summary.box_min = state[summary.begin].position;
+    summary.box_max = state[summary.begin].position;
+    f64 weighted_x = 0.0;
+    f64 weighted_y = 0.0;
+    for(i64 i = summary.begin; i < summary.end; ++i) {
+        Point_Mass const& point_mass = state[i];
+        summary.box_min.x = math::min(summary.box_min.x, point_mass.position.x);
+        summary.box_min.y = math::min(summary.box_min.y, point_mass.position.y);
+        summary.box_max.x = math::max(summary.box_max.x, point_mass.position.x);
+        summary.box_max.y = math::max(summary.box_max.y, point_mass.position.y);
+        summary.mass += point_mass.mass;
+        weighted_x += (f64)point_mass.position.x * point_mass.mass;
+        weighted_y += (f64)point_mass.position.y * point_mass.mass;
+    }
+
+    if(summary.mass <= 0.0) {
+        return;
+    }
+
+    summary.center_x = weighted_x / summary.mass;
+    summary.center_y = weighted_y / summary.mass;
+    // Q_ij = sum m (3 x_i x_j - r^2 d_ij) restricted to the plane.
+    for(i64 i = summary.begin; i < summary.end; ++i) {
+        Point_Mass const& point_mass = state[i];
+        f64 const dx = point_mass.position.x - summary.center_x;
+        f64 const dy = point_mass.position.y - summary.center_y;
+        summary.quadrupole_xx += point_mass.mass * (2.0 * dx * dx - dy * dy);
+        summary.quadrupole_xy += point_mass.mass * 3.0 * dx * dy;
+        summary.quadrupole_yy += point_mass.mass * (2.0 * dy * dy - dx * dx);
+    }
+}
+
+// The domain other may be approximated by its multipole when it is small compared to
+// the distance between its center of mass and the box of the domain own.
+static bool is_far(Domain_Summary const& own, Domain_Summary const& other, f32 const opening_angle) {
+    f64 const size = math::max(other.box_max.x - other.box_min.x, other.box_max.y - other.box_min.y);
+    f64 const dx = math::max(math::max(own.box_min.x - other.center_x, 0.0), other.center_x - own.box_max.x);
+    f64 const dy = math::max(math::max(own.box_min.y - other.center_y, 0.0), other.center_y - own.box_max.y);
+    return size * size < (f64)opening_angle * opening_angle * (dx * dx + dy * dy);
+}
+
+// Acceleration at position from the quadrupole expansion of the domain. The monopole is softened
+// with Kernel like the pairwise forces. The quadrupole correction is only significant far from the
+// domain, beyond the softening, hence it is Newtonian with the distance clamped to the softening length.
+template<typename Kernel>
+static Vec2 compute_multipole_acceleration(Domain_Summary const& summary, Vec2 const position, f32 const softening_length) {
+    f64 const rx = position.x - summary.center_x;
+    f64 const ry = position.y - summary.center_y;
+    f64 const r2 = rx * rx + ry * ry;
+    f64 const h = softening_length;
+    f64 const G = gravitational_constant;
+    f64 const monopole_factor = Kernel::get_force_factor(r2, h);
+    f64 const inverse_r2 = 1.0 / math::max(r2, h * h);
+    f64 const inverse_r3 = std::sqrt(inverse_r2) * inverse_r2;
+    f64 const inverse_r5 = inverse_r3 * inverse_r2;
+    f64 const inverse_r7 = inverse_r5 * inverse_r2;
+    f64 const qrx = summary.quadrupole_xx * rx + summary.quadrupole_xy * ry;
+    f64 const qry = summary.quadrupole_xy * rx + summary.quadrupole_yy * ry;
+    f64 const rqr = rx * qrx + ry * qry;
+    // a = -G M r / r^3 + G (Q r / r^5 - 5/2 (r Q r) r / r^7)
+    f64 const ax = -G * summary.mass * rx * monopole_factor + G * (qrx * inverse_r5 - 2.5 * rqr * rx * inverse_r7);
+    f64 const ay = -G * summary.mass * ry * monopole_factor + G * (qry * inverse_r5 - 2.5 * rqr * ry * inverse_r7);
+    return Vec2{(f32)ax, (f32)ay};
+}
+
+// Advances the bodies of the domain by a single substep from state to next_state.
+template<typename Kernel>
+static void step_domain(Shared_Header const& header, i32 const domain, Point_Mass const* const state, Point_Mass* const next_state,
+                        Worker_Scratch& scratch) {
+    Physics_Settings const& settings = header.settings;
+    Domain_Summary const& own = header.domains[domain];
+    i64 const own_count = own.end - own.begin;
+    // The own bodies come first so that the local index of a body is its index within the domain.
+    scratch.sources.clear();
+    scratch.far_domains.clear();
+    for(i64 i = own.begin; i < own.end; ++i) {
+        scratch.sources.emplace_back(state[i]);
+    }
+
+    for(i32 other = 0; other < header.domain_count; ++other) {
+        Domain_Summary const& summary = header.domains[other];
+        if(other == domain || summary.begin == summary.end) {
+            continue;
+        }
+
+        // The direct solver must remain exact.
+        if(settings.solver == Force_Solver::tree && is_far(own, summary, settings.opening_angle)) {
+            scratch.far_domains.emplace_back(other);
+        } else {
+            for(i64 i = summary.begin; i < summary.end; ++i) {
+                scratch.sources.emplace_back(state[i]);
+            }
+        }
+    }
+
+    Slice<Point_Mass const> const sources{scratch.sources.begin(), scratch.sources.end()};
+    if(settings.solver == Force_Solver::tree) {
+        build_quadtree(scratch.tree, sources, settings.leaf_size);
+    }
+
+    auto compute_acceleration = [&header, &settings, &scratch, sources](i64 const self, Vec2 const position) {
+        Vec2 acceleration;
+        if(settings.solver == Force_Solver::tree) {
+            acceleration = compute_quadtree_acceleration<Kernel>(scratch.tree, sources, position, self, settings.opening_angle, settings.softening_length);
+        } else {
+            for(i64 i = 0; i < sources.size(); ++i) {
+                f32 const mass = i != self ? sources[i].mass : 0.0f;
+                acceleration += gravitational_acceleration<Kernel>(sources[i].position, mass, position, settings.softening_length);
+            }
+        }
+
+        for(i32 const other: scratch.far_domains) {
+            acceleration += compute_multipole_acceleration<Kernel>(header.domains[other], position, settings.softening_length);
+        }
+        return acceleration;
+    };
+
+    f32 const timestep = settings.timestep;
+    scratch.accelerations.resize(own_count);
+    scratch.positions_next.resize(own_count);
+    for(i64 i = 0; i < own_count; ++i) {
+        Point_Mass const& point_mass = sources[i];
+        Vec2 const acceleration = compute_acceleration(i, point_mass.position);
+        scratch.accelerations[i] = acceleration;
+        scratch.positions_next[i] = point_mass.position + point_mass.velocity * timestep + 0.5f * acceleration * timestep * timestep;
+    }
+
+    for(i64 i = 0; i < own_count; ++i) {
+        Point_Mass const& point_mass = sources[i];
+        Vec2 const acceleration = compute_acceleration(i, scratch.positions_next[i]);
+        Vec2 const velocity = point_mass.velocity + 0.5f * (scratch.accelerations[i] + acceleration) * timestep;
+        next_state[own.begin + i] = Point_Mass{scratch.positions_next[i], velocity, point_mass.mass};
+    }
+}
+
+// Range of the bodies of every domain after bisect. Depends only on the number of bodies.
+static void split_domain_ranges(i64 const begin, i64 const end, i32 const first_domain, i32 const domain_count, Domain_Summary* const domains) {
+    if(domain_count == 1) {
+        domains[first_domain].begin = begin;
+        domains[first_domain].end = end;
+        return;
+    }
+
+    i32 const left_domains = domain_count / 2;
+    i64 const middle = begin + (end - begin) * left_domains / domain_count;
+    split_domain_ranges(begin, middle, first_domain, left_domains, domains);
+    split_domain_ranges(middle, end, first_domain + left_domains, domain_count - left_domains, domains);
+}
+
+[[noreturn]] static void worker_main(Shared_Header* const header, Point_Mass* const state0, Point_Mass* const state1, i32 const domain,
+                                     i32 const numa_node, i64 const body_count) {
+    // Die with the coordinator instead of waiting on the barrier forever.
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    // Only the forking thread exists in the worker. The trace buffers and the thread pool
+    // of the coordinator must not be touched.
+    set_tracing_enabled(false);
+    if(numa_node >= 0) {
+        pin_to_numa_node(numa_node);
+    }
+
+    Point_Mass* const states[2] = {state0, state1};
+    if(numa_node >= 0) {
+        // The pages are allocated on the node of the first touch. The coordinator waits until
+        // every worker has touched the range its domain will own.
+        Domain_Summary ranges[max_domains];
+        split_domain_ranges(0, body_count, 0, header->domain_count, ranges);
+        Domain_Summary const& range = ranges[domain];
+        for(Point_Mass* const state: states) {
+            for(i64 i = range.begin; i < range.end; ++i) {
+                state[i] = Point_Mass{};
+            }
+        }
+    }
+    pthread_barrier_wait(&header->control_barrier);
+
+    Worker_Scratch scratch;
+    while(true) {
+        pthread_barrier_wait(&header->control_barrier);
+        if(header->command == Domain_Command::quit) {
+            _exit(0);
+        }
+
+        i32 current = header->current;
+        compute_summary(header->domains[domain], states[current]);
+        pthread_barrier_wait(&header->step_barrier);
+        for(i64 step = 0; step < header->step_count; ++step) {
+            with_softening_kernel(header->settings.softening, [&](auto const kernel) {
+                step_domain<decltype(kernel)>(*header, domain, states[current], states[1 - current], scratch);
+            });
+            pthread_barrier_wait(&header->step_barrier);
+            current = 1 - current;
+            compute_summary(header->domains[domain], states[current]);
+            pthread_barrier_wait(&header->step_barrier);
+        }
+        pthread_barrier_wait(&header->control_barrier);
+    }
+}
+
+// Orthogonal recursive bisection. Splits the bodies along the longer side of their
+// bounding box in proportion to the number of domains on either side.
+static void bisect(Point_Mass const* const state, i64* const order, i64 const begin, i64 const end, i32 const first_domain, i32 const domain_count,
+                   Domain_Summary* const domains) {
+    if(domain_count == 1) {
+        domains[first_domain].begin = begin;
+        domains[first_domain].end = end;
+        return;
+    }
+
+    Vec2 min_bound{0.0f, 0.0f};
+    Vec2 max_bound{0.0f, 0.0f};
+    if(begin < end) {
+        min_bound = state[order[begin]].position;
+        max_bound = state[order[begin]].position;
+    }
+
+    for(i64 i = begin; i < end; ++i) {
+        Vec2 const position = state[order[i]].position;
+        min_bound.x = math::min(min_bound.x, position.x);
+        min_bound.y = math::min(min_bound.y, position.y);
+        max_bound.x = math::max(max_bound.x, position.x);
+        max_bound.y = math::max(max_bound.y, position.y);
+    }
+
+    bool const split_x = max_bound.x - min_bound.x >= max_bound.y - min_bound.y;
+    // Same split as split_domain_ranges.
+    i32 const left_domains = domain_count / 2;
+    i64 const middle = begin + (end - begin) * left_domains / domain_count;
+    std::nth_element(order + begin, order + middle, order + end, [state, split_x](i64 const lhs, i64 const rhs) {
+        return split_x ? state[lhs].position.x < state[rhs].position.x : state[lhs].position.y < state[rhs].position.y;
+    });
+    bisect(state, order, begin, middle, first_domain, left_domains, domains);
+    bisect(state, order, middle, end, first_domain + left_domains, domain_count - left_domains, domains);
+}
+
+// Reorders the bodies in the shared state so that every domain is a contiguous range.
+// Must be called while the workers wait.
+static void rebalance(Domain_Decomposition& domain_decomposition) {
+    TRACE_ZONE("domain_rebalance");
+    Shared_Header& header = *domain_decomposition.header;
+    i64 const count = header.body_count;
+    Point_Mass const* const state = domain_decomposition.states[header.current];
+    Point_Mass* const reordered = domain_decomposition.states[1 - header.current];
+    Array<i64>& order = domain_decomposition.order;
+    order.resize(count);
+    for(i64 i = 0; i < count; ++i) {
+        order[i] = i;
+    }
+
+    bisect(state, order.data(), 0, count, 0, header.domain_count, header.domains);
+    Array<i64>& permutation = domain_decomposition.permutation;
+    Array<i64>& permutation_scratch = domain_decomposition.permutation_scratch;
+    permutation_scratch.resize(count);
+    for(i64 i = 0; i < count; ++i) {
+        reordered[i] = state[order[i]];
+        permutation_scratch[i] = permutation[order[i]];
+    }
+
+    for(i64 i = 0; i < count; ++i) {
+        permutation[i] = permutation_scratch[i];
+    }
+
+    header.current = 1 - header.current;
+    domain_decomposition.steps_since_rebalance = 0;
+    domain_decomposition.balanced = true;
+}
+
+// Runs step_count substeps. function is called with the state at the beginning of the substeps
+// while the workers run, which only reads it, hence it requires step_count to be 1.
+static void run_workers(Domain_Decomposition& domain_decomposition, i64 const step_count, Domain_Substep_Function const function, void* const user_data) {
+    Shared_Header& header = *domain_decomposition.header;
+    header.command = Domain_Command::step;
+    header.step_count = step_count;
+    pthread_barrier_wait(&header.control_barrier);
+    if(function != nullptr) {
+        Point_Mass const* const state = domain_decomposition.states[header.current];
+        function(Slice<Point_Mass const>{state, state + header.body_count}, user_data);
+    }
+    pthread_barrier_wait(&header.control_barrier);
+    header.current = (header.current + step_count) % 2;
+    domain_decomposition.steps_since_rebalance += step_count;
+}
+
+bool is_domain_decomposition_supported() {
+    return true;
+}
+
+Domain_Decomposition* create_domain_decomposition(Physics_Settings const& settings, i64 const capacity, i64 const body_count) {
+    i32 const process_count = math::clamp(settings.process_count, 1, max_domains);
+    // The states start on a page of their own, so that the header touched by the coordinator
+    // does not decide the node of the first bodies.
+    i64 const page_size = sysconf(_SC_PAGESIZE);
+    i64 const header_size = (sizeof(Shared_Header) + page_size - 1) / page_size * page_size;
+    i64 const mapping_size = header_size + 2 * capacity * sizeof(Point_Mass);
+    void* const mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    ANTON_FAIL(mapping != MAP_FAILED, "failed to map the shared memory of the domain decomposition");
+
+    Domain_Decomposition* const domain_decomposition = new Domain_Decomposition;
+    domain_decomposition->settings = settings;
+    domain_decomposition->capacity = capacity;
+    domain_decomposition->mapping = mapping;
+    domain_decomposition->mapping_size = mapping_size;
+    domain_decomposition->states[0] = (Point_Mass*)((u8*)mapping + header_size);
+    domain_decomposition->states[1] = domain_decomposition->states[0] + capacity;
+
+    Shared_Header* const header = new(mapping) Shared_Header;
+    domain_decomposition->header = header;
+    header->settings = settings;
+    // A forked worker has a single thread and must never use the thread pool.
+    header->settings.thread_count = 1;
+    header->command = Domain_Command::step;
+    header->step_count = 0;
+    header->body_count = 0;
+    header->current = 0;
+    header->domain_count = process_count;
+    for(Domain_Summary& summary: header->domains) {
+        summary = Domain_Summary{};
+    }
+
+    pthread_barrierattr_t attributes;
+    pthread_barrierattr_init(&attributes);
+    pthread_barrierattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_barrier_init(&header->control_barrier, &attributes, process_count + 1);
+    pthread_barrier_init(&header->step_barrier, &attributes, process_count);
+    pthread_barrierattr_destroy(&attributes);
+
+    i32 const numa_node_count = count_numa_nodes();
+    for(i32 domain = 0; domain < process_count; ++domain) {
+        // Spread the workers over the nodes. Pinning a single node machine gains nothing.
+        i32 const numa_node = numa_node_count > 1 ? domain % numa_node_count : -1;
+        pid_t const pid = fork();
+        ANTON_FAIL(pid >= 0, "failed to fork a domain worker");
+        if(pid == 0) {
+            worker_main(header, domain_decomposition->states[0], domain_decomposition->states[1], domain, numa_node,
+                        math::clamp(body_count, (i64)0, capacity));
+        }
+        domain_decomposition->workers.emplace_back(pid);
+    }
+    // Wait for the first touch of the states.
+    pthread_barrier_wait(&header->control_barrier);
+    return domain_decomposition;
+}
+
+void destroy_domain_decomposition(Domain_Decomposition* const domain_decomposition) {
+    Shared_Header& header = *domain_decomposition->header;
+    header.command = Domain_Command::quit;
+    pthread_barrier_wait(&header.control_barrier);
+    for(pid_t const pid: domain_decomposition->workers) {
+        waitpid(pid, nullptr, 0);
+    }
+
+    pthread_barrier_destroy(&header.control_barrier);
+    pthread_barrier_destroy(&header.step_barrier);
+    header.~Shared_Header();
+    munmap(domain_decomposition->mapping, domain_decomposition->mapping_size);
+    delete domain_decomposition;
+}
+
+i64 get_domain_decomposition_capacity(Domain_Decomposition const& domain_decomposition) {
+    return domain_decomposition.capacity;
+}
+
+void step_domain_decomposition(Domain_Decomposition& domain_decomposition, Slice<Point_Mass> const point_masses, i64 const step_count,
+                               Domain_Substep_Function const function, void* const user_data) {
+    TRACE_ZONE("step_domain_decomposition");
+    i64 const count = point_masses.size();
+    ANTON_FAIL(count <= domain_decomposition.capacity, "too many point masses for the domain decomposition");
+    Shared_Header& header = *domain_decomposition.header;
+    Array<i64>& permutation = domain_decomposition.permutation;
+    if(count != header.body_count) {
+        header.body_count = count;
+        permutation.resize(count);
+        for(i64 i = 0; i < count; ++i) {
+            permutation[i] = i;
+        }
+        domain_decomposition.balanced = false;
+    }
+
+    // The caller may have modified the point masses between the calls.
+    Point_Mass* state = domain_decomposition.states[header.current];
+    for(i64 i = 0; i < count; ++i) {
+        state[i] = point_masses[permutation[i]];
+    }
+
+    i64 const rebalance_interval = math::max(domain_decomposition.settings.rebalance_interval, (i64)1);
+    i64 remaining = step_count;
+    while(remaining > 0) {
+        if(!domain_decomposition.balanced || domain_decomposition.steps_since_rebalance >= rebalance_interval) {
+            rebalance(domain_decomposition);
+        }
+
+        // The workers overwrite the state of a substep during the next one. function needs every state, hence a substep at a time.
+        i64 const steps = function != nullptr ? 1 : math::min(remaining, rebalance_interval - domain_decomposition.steps_since_rebalance);
+        run_workers(domain_decomposition, steps, function, user_data);
+        remaining -= steps;
+    }
+
+    state = domain_decomposition.states[header.current];
+    for(i64 i = 0; i < count; ++i) {
+        point_masses[permutation[i]] = state[i];
+    }
+}
+
+#else
+
+bool is_domain_decomposition_supported() {
+    return false;
+}
+
+Domain_Decomposition* create_domain_decomposition(Physics_Settings const&, i64, i64) {
+    return nullptr;
+}
+
+void destroy_domain_decomposition(Domain_Decomposition*) {}
+
+i64 get_domain_decomposition_capacity(Domain_Decomposition const&) {
+    return 0;
+}
+
+void step_domain_decomposition(Domain_Decomposition&, Slice<Point_Mass>, i64, Domain_Substep_Function, void*) {}
+
+#endif
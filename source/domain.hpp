@@ -0,0 +1,61 @@
+#pragma once
+
+#include <anton/slice.hpp>
+#include <build.hpp>
+#include <physics.hpp>
+
+struct Point_Mass;
+struct Domain_Decomposition;
+
+// Multi-process domain decomposition. Linux only.
+// The bodies are split into settings.process_count spatial domains by orthogonal recursive
+// bisection. Every domain is owned by a worker process pinned to a NUMA node. The state of
+// the bodies and the multipoles of the domains live in shared memory. A worker reads the
+// bodies of the domains near its own directly and, with the tree solver, approximates the
+// distant domains by their quadrupole expansions. The pages of the state that a domain owns
+// are first touched by its worker, hence they are local to its node.
+
+// is_domain_decomposition_supported
+//
+// Returns:
+// true if the platform supports the domain decomposition.
+//
+[[nodiscard]] bool is_domain_decomposition_supported();
+
+// create_domain_decomposition
+// Maps the shared memory for capacity bodies and forks the worker processes.
+//
+// Parameters:
+// body_count - expected number of bodies. The state is placed on the nodes of the domains
+//              that own the bodies when there are body_count of them.
+//
+[[nodiscard]] Domain_Decomposition* create_domain_decomposition(Physics_Settings const& settings, i64 capacity, i64 body_count);
+
+// destroy_domain_decomposition
+// Stops the worker processes and releases the shared memory.
+//
+void destroy_domain_decomposition(Domain_Decomposition* domain_decomposition);
+
+[[nodiscard]] i64 get_domain_decomposition_capacity(Domain_Decomposition const& domain_decomposition);
+
+using Domain_Substep_Function = void (*)(Slice<Point_Mass const> sources, void* user_data);
+
+// step_domain_decomposition
+// Advances the point masses by step_count substeps with the scheme of step_physics.
+// The domains are rebalanced every settings.rebalance_interval substeps.
+//
+// Parameters:
+// point_masses - at most capacity point masses.
+// function     - called on the calling process with the bodies at the beginning of every substep
+//                while the workers integrate it, e.g. to advance the tracers. The order of the
+//                sources is unspecified. Optional.
+//
+void step_domain_decomposition(Domain_Decomposition& domain_decomposition, Slice<Point_Mass> point_masses, i64 step_count,
+                               Domain_Substep_Function function = nullptr, void* user_data = nullptr);
+
+template<typename Function>
+void step_domain_decomposition(Domain_Decomposition& domain_decomposition, Slice<Point_Mass> const point_masses, i64 const step_count,
+                               Function const& function) {
+    Domain_Substep_Function const invoke = [](Slice<Point_Mass const> const sources, void* const user_data) { (*(Function const*)user_data)(sources); };
+    step_domain_decomposition(domain_decomposition, point_masses, step_count, invoke, (void*)&function);
+}
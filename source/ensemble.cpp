@@ -0,0 +1,328 @@
+#include <ensemble.hpp>
+
+#include <anton/assert.hpp>
+#include <gravity.hpp>
+#include <physics.hpp>
+#include <threads.hpp>
+#include <trace.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// Number of members advanced together. 8 f32 lanes fill a 256 bit vector.
+constexpr i64 lane_count = 8;
+// Maximum number of members processed by a single task.
+constexpr i64 members_per_task = 4 * lane_count;
+constexpr f32 no_approach = 3.4e38f;
+
+// Members of the same size in structure of arrays layout. The arrays are indexed
+// by body * lane_count + lane so that the innermost loops run over the members.
+struct Batch {
+    i64 body_count;
+    Array<f32> x;
+    Array<f32> y;
+    Array<f32> vx;
+    Array<f32> vy;
+    Array<f32> mass;
+    Array<f32> next_x;
+    Array<f32> next_y;
+    Array<f32> ax1;
+    Array<f32> ay1;
+    Array<f32> ax2;
+    Array<f32> ay2;
+    // Index of the member in each lane. -1 when the lane is empty.
+    i64 member[lane_count];
+    i64 steps[lane_count];
+    // Smallest squared distance between two bodies during the last step and overall.
+    f32 step_approach_squared[lane_count];
+    f32 closest_approach_squared[lane_count];
+};
+
+struct Task {
+    // Range of the sorted member indices.
+    i64 begin;
+    i64 end;
+};
+
+// Accelerations at the targets exerted by the bodies of the batch at their current positions.
+// A body does not act on itself. When approach_squared is not null, it receives the smallest
+// squared distance between a target and a source in each lane.
+template<typename Kernel>
+static void compute_batch_accelerations(Batch const& batch, f32 const* const target_x, f32 const* const target_y, f32* const ax, f32* const ay,
+                                        f32* const approach_squared, f32 const softening_length) {
+    i64 const body_count = batch.body_count;
+    f32 const* const source_x = batch.x.data();
+    f32 const* const source_y = batch.y.data();
+    f32 const* const source_mass = batch.mass.data();
+    f32 closest[lane_count];
+    for(i64 lane = 0; lane < lane_count; ++lane) {
+        closest[lane] = no_approach;
+    }
+
+    for(i64 i = 0; i < body_count; ++i) {
+        f32 sum_x[lane_count] = {};
+        f32 sum_y[lane_count] = {};
+        f32 const* const tx = target_x + i * lane_count;
+        f32 const* const ty = target_y + i * lane_count;
+        for(i64 j = 0; j < body_count; ++j) {
+            if(j == i) {
+                continue;
+            }
+
+            f32 const* const sx = source_x + j * lane_count;
+            f32 const* const sy = source_y + j * lane_count;
+            f32 const* const sm = source_mass + j * lane_count;
+            for(i64 lane = 0; lane < lane_count; ++lane) {
+                f32 const dx = sx[lane] - tx[lane];
+                f32 const dy = sy[lane] - ty[lane];
+                f32 const distance_squared = dx * dx + dy * dy;
+                // The kernel does not branch, hence the lanes vectorize.
+                f32 const magnitude = gravitational_constant * sm[lane] * Kernel::get_force_factor(distance_squared, softening_length);
+                sum_x[lane] += dx * magnitude;
+                sum_y[lane] += dy * magnitude;
+                closest[lane] = math::min(closest[lane], distance_squared);
+            }
+        }
+
+        for(i64 lane = 0; lane < lane_count; ++lane) {
+            ax[i * lane_count + lane] = sum_x[lane];
+            ay[i * lane_count + lane] = sum_y[lane];
+        }
+    }
+
+    if(approach_squared) {
+        for(i64 lane = 0; lane < lane_count; ++lane) {
+            approach_squared[lane] = closest[lane];
+        }
+    }
+}
+
+// Same scheme as step_physics. The accelerations at t+dt are evaluated at the
+// predicted positions of the targets with the sources at their positions at t.
+template<typename Kernel>
+static void step_batch(Batch& batch, f32 const timestep, f32 const softening_length) {
+    i64 const size = batch.body_count * lane_count;
+    compute_batch_accelerations<Kernel>(batch, batch.x.data(), batch.y.data(), batch.ax1.data(), batch.ay1.data(), batch.step_approach_squared,
+                                        softening_length);
+    for(i64 i = 0; i < size; ++i) {
+        batch.next_x[i] = batch.x[i] + batch.vx[i] * timestep + 0.5f * batch.ax1[i] * timestep * timestep;
+        batch.next_y[i] = batch.y[i] + batch.vy[i] * timestep + 0.5f * batch.ay1[i] * timestep * timestep;
+    }
+
+    compute_batch_accelerations<Kernel>(batch, batch.next_x.data(), batch.next_y.data(), batch.ax2.data(), batch.ay2.data(), nullptr, softening_length);
+    for(i64 i = 0; i < size; ++i) {
+        batch.x[i] = batch.next_x[i];
+        batch.y[i] = batch.next_y[i];
+        batch.vx[i] += 0.5f * (batch.ax1[i] + batch.ax2[i]) * timestep;
+        batch.vy[i] += 0.5f * (batch.ay1[i] + batch.ay2[i]) * timestep;
+    }
+}
+
+static void load_lane(Batch& batch, i64 const lane, i64 const member_index, Ensemble_Member const& member) {
+    for(i64 body = 0; body < batch.body_count; ++body) {
+        i64 const index = body * lane_count + lane;
+        Point_Mass const& point_mass = member.point_masses[body];
+        batch.x[index] = point_mass.position.x;
+        batch.y[index] = point_mass.position.y;
+        batch.vx[index] = point_mass.velocity.x;
+        batch.vy[index] = point_mass.velocity.y;
+        batch.mass[index] = point_mass.mass;
+    }
+    batch.member[lane] = member_index;
+    batch.steps[lane] = 0;
+    batch.closest_approach_squared[lane] = no_approach;
+}
+
+// Empty lanes have no mass and exert no forces.
+static void clear_lane(Batch& batch, i64 const lane) {
+    for(i64 body = 0; body < batch.body_count; ++body) {
+        i64 const index = body * lane_count + lane;
+        batch.x[index] = 0.0f;
+        batch.y[index] = 0.0f;
+        batch.vx[index] = 0.0f;
+        batch.vy[index] = 0.0f;
+        batch.mass[index] = 0.0f;
+    }
+    batch.member[lane] = -1;
+}
+
+static void write_result(Ensemble_Member const& member, Ensemble_Settings const& settings, Ensemble_Result& result, Ensemble_Stop_Reason const stop_reason,
+                         i64 const steps, f32 const closest_approach_squared, Array<Point_Mass>&& point_masses) {
+    f64 const initial_energy = compute_total_energy(Slice<Point_Mass const>{member.point_masses.begin(), member.point_masses.end()}, 1, settings.softening,
+                                                    settings.softening_length);
+    f64 const final_energy =
+        compute_total_energy(Slice<Point_Mass const>{point_masses.begin(), point_masses.end()}, 1, settings.softening, settings.softening_length);
+    result.stop_reason = stop_reason;
+    result.time = (f64)steps * settings.timestep;
+    result.steps = steps;
+    result.closest_approach = closest_approach_squared < no_approach ? std::sqrt(closest_approach_squared) : 0.0f;
+    result.energy_drift = initial_energy != 0.0 ? std::abs((final_energy - initial_energy) / initial_energy) : 0.0;
+    result.point_masses = ANTON_MOV(point_masses);
+}
+
+static bool has_escaped(Batch const& batch, i64 const lane, f32 const escape_distance) {
+    f64 mass = 0.0;
+    f64 weighted_x = 0.0;
+    f64 weighted_y = 0.0;
+    for(i64 body = 0; body < batch.body_count; ++body) {
+        i64 const index = body * lane_count + lane;
+        mass += batch.mass[index];
+        weighted_x += (f64)batch.x[index] * batch.mass[index];
+        weighted_y += (f64)batch.y[index] * batch.mass[index];
+    }
+
+    if(mass <= 0.0) {
+        return false;
+    }
+
+    f64 const center_x = weighted_x / mass;
+    f64 const center_y = weighted_y / mass;
+    f64 const escape_distance_squared = (f64)escape_distance * escape_distance;
+    for(i64 body = 0; body < batch.body_count; ++body) {
+        i64 const index = body * lane_count + lane;
+        f64 const dx = batch.x[index] - center_x;
+        f64 const dy = batch.y[index] - center_y;
+        if(dx * dx + dy * dy > escape_distance_squared) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Runs the members with the given indices, all of the same size, in a single batch.
+template<typename Kernel>
+static void run_task(Slice<Ensemble_Member const> const members, Slice<i64 const> const indices, Ensemble_Settings const& settings,
+                     Slice<Ensemble_Result> const results) {
+    f32 const timestep = settings.timestep;
+    Batch batch;
+    batch.body_count = members[indices[0]].point_masses.size();
+    i64 const size = batch.body_count * lane_count;
+    batch.x.resize(size);
+    batch.y.resize(size);
+    batch.vx.resize(size);
+    batch.vy.resize(size);
+    batch.mass.resize(size);
+    batch.next_x.resize(size);
+    batch.next_y.resize(size);
+    batch.ax1.resize(size);
+    batch.ay1.resize(size);
+    batch.ax2.resize(size);
+    batch.ay2.resize(size);
+
+    i64 next_member = 0;
+    // Loads the next member into the lane or clears the lane when there are none left.
+    auto fill_lane = [&](i64 const lane) {
+        while(next_member < indices.size()) {
+            i64 const index = indices[next_member];
+            next_member += 1;
+            Ensemble_Member const& member = members[index];
+            if(member.max_time > 0.0) {
+                load_lane(batch, lane, index, member);
+                return;
+            }
+
+            Array<Point_Mass> point_masses = member.point_masses;
+            write_result(member, settings, results[index], Ensemble_Stop_Reason::max_time, 0, no_approach, ANTON_MOV(point_masses));
+        }
+        clear_lane(batch, lane);
+    };
+
+    for(i64 lane = 0; lane < lane_count; ++lane) {
+        fill_lane(lane);
+    }
+
+    while(true) {
+        bool active = false;
+        for(i64 lane = 0; lane < lane_count; ++lane) {
+            active |= batch.member[lane] != -1;
+        }
+
+        if(!active) {
+            break;
+        }
+
+        step_batch<Kernel>(batch, timestep, settings.softening_length);
+        for(i64 lane = 0; lane < lane_count; ++lane) {
+            i64 const index = batch.member[lane];
+            if(index == -1) {
+                continue;
+            }
+
+            Ensemble_Member const& member = members[index];
+            batch.steps[lane] += 1;
+            batch.closest_approach_squared[lane] = math::min(batch.closest_approach_squared[lane], batch.step_approach_squared[lane]);
+            bool stopped = true;
+            Ensemble_Stop_Reason stop_reason = Ensemble_Stop_Reason::max_time;
+            if(batch.step_approach_squared[lane] < member.collision_distance * member.collision_distance) {
+                stop_reason = Ensemble_Stop_Reason::collision;
+            } else if(member.escape_distance > 0.0f && has_escaped(batch, lane, member.escape_distance)) {
+                stop_reason = Ensemble_Stop_Reason::escape;
+            } else if((f64)batch.steps[lane] * timestep < member.max_time) {
+                stopped = false;
+            }
+
+            if(!stopped) {
+                continue;
+            }
+
+            Array<Point_Mass> point_masses{reserve, batch.body_count};
+            for(i64 body = 0; body < batch.body_count; ++body) {
+                i64 const i = body * lane_count + lane;
+                point_masses.emplace_back(Point_Mass{Vec2{batch.x[i], batch.y[i]}, Vec2{batch.vx[i], batch.vy[i]}, batch.mass[i]});
+            }
+            write_result(member, settings, results[index], stop_reason, batch.steps[lane], batch.closest_approach_squared[lane], ANTON_MOV(point_masses));
+            fill_lane(lane);
+        }
+    }
+}
+
+void run_ensemble(Slice<Ensemble_Member const> const members, Ensemble_Settings const& settings, Slice<Ensemble_Result> const results) {
+    TRACE_ZONE("run_ensemble");
+    ANTON_FAIL(members.size() == results.size(), "there must be a result for every member");
+    ANTON_ASSERT(settings.timestep > 0.0f, "timestep must be greater than 0");
+    // Group the members by size.
+    Array<i64> order{reserve, members.size()};
+    for(i64 i = 0; i < members.size(); ++i) {
+        order.emplace_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [members](i64 const lhs, i64 const rhs) { return members[lhs].point_masses.size() < members[rhs].point_masses.size(); });
+
+    // Split every group into tasks so that all batches of all groups are spread over the threads.
+    Array<Task> tasks;
+    for(i64 group_begin = 0; group_begin < order.size();) {
+        i64 const body_count = members[order[group_begin]].point_masses.size();
+        i64 group_end = group_begin;
+        while(group_end < order.size() && members[order[group_end]].point_masses.size() == body_count) {
+            group_end += 1;
+        }
+
+        for(i64 begin = group_begin; begin < group_end; begin += members_per_task) {
+            tasks.emplace_back(Task{begin, math::min(begin + members_per_task, group_end)});
+        }
+        group_begin = group_end;
+    }
+
+    Slice<i64 const> const order_slice{order.begin(), order.end()};
+    with_softening_kernel(settings.softening, [&](auto const kernel) {
+        using Kernel = decltype(kernel);
+        parallel_for(tasks.size(), 1, settings.thread_count, [members, results, order_slice, &settings, &tasks](i64 const begin, i64 const end) {
+            for(i64 i = begin; i < end; ++i) {
+                Task const& task = tasks[i];
+                run_task<Kernel>(members, Slice<i64 const>{order_slice.begin() + task.begin, order_slice.begin() + task.end}, settings, results);
+            }
+        });
+    });
+}
+
+String_View stringify(Ensemble_Stop_Reason const reason) {
+    switch(reason) {
+        case Ensemble_Stop_Reason::max_time:
+            return u8"max_time";
+        case Ensemble_Stop_Reason::collision:
+            return u8"collision";
+        case Ensemble_Stop_Reason::escape:
+            return u8"escape";
+    }
+    return u8"unknown";
+}
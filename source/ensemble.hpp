@@ -0,0 +1,58 @@
+#pragma once
+
+#include <anton/array.hpp>
+#include <anton/slice.hpp>
+#include <anton/string_view.hpp>
+#include <build.hpp>
+#include <gravity.hpp>
+#include <point_mass.hpp>
+
+struct Ensemble_Member {
+    Array<Point_Mass> point_masses;
+    // Simulated time after which the member stops in seconds.
+    f64 max_time = 1.0;
+    // Stop when any two bodies are closer than collision_distance. Disabled when 0.
+    f32 collision_distance = 0.0f;
+    // Stop when any body is farther than escape_distance from the center of mass. Disabled when 0.
+    f32 escape_distance = 0.0f;
+};
+
+enum struct Ensemble_Stop_Reason {
+    max_time,
+    collision,
+    escape,
+};
+
+struct Ensemble_Result {
+    Ensemble_Stop_Reason stop_reason;
+    // Simulated time at which the member stopped in seconds.
+    f64 time;
+    i64 steps;
+    // Smallest distance between any two bodies at the beginning of a step.
+    f32 closest_approach;
+    // Relative change of the total energy.
+    f64 energy_drift;
+    Array<Point_Mass> point_masses;
+};
+
+struct Ensemble_Settings {
+    // Fixed timestep of all members. Must be greater than 0.
+    f32 timestep = 1.0f / 240.0f;
+    // Maximum number of threads to use.
+    i32 thread_count = 1;
+    Softening softening = Softening::spline;
+    f32 softening_length = 1.0f;
+};
+
+// run_ensemble
+// Integrates the independent members with the scheme of step_physics and the direct sum.
+// Members with the same number of bodies are packed into batches that advance several
+// members at once, one per lane. A lane that stops is refilled with the next member.
+// The batches are spread over the threads.
+//
+// Parameters:
+// results - one per member.
+//
+void run_ensemble(Slice<Ensemble_Member const> members, Ensemble_Settings const& settings, Slice<Ensemble_Result> results);
+
+[[nodiscard]] String_View stringify(Ensemble_Stop_Reason reason);
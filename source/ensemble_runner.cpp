@@ -0,0 +1,219 @@
+// Runs an ensemble of independent small simulations described by a manifest and
+// prints a csv record per member.
+
+#include <anton/array.hpp>
+#include <anton/console.hpp>
+#include <anton/filesystem.hpp>
+#include <anton/format.hpp>
+#include <anton/string.hpp>
+#include <build.hpp>
+#include <ensemble.hpp>
+#include <file.hpp>
+#include <physics.hpp>
+#include <point_mass.hpp>
+#include <scene.hpp>
+#include <threads.hpp>
+
+#include <chrono>
+
+struct Runner_Options {
+    String manifest_path;
+    String states_path;
+    Ensemble_Settings settings;
+    // Defaults of the stopping criteria of the members that do not specify them.
+    f64 max_time = 1.0;
+    f32 collision_distance = 0.0f;
+    f32 escape_distance = 0.0f;
+};
+
+struct Loaded_Scene {
+    String path;
+    Array<Point_Mass> point_masses;
+};
+
+static f64 get_time_ms() {
+    auto const now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<f64, std::milli>(now).count();
+}
+
+static bool parse_options(i32 const argc, char** const argv, Runner_Options& options) {
+    Console_Output cout;
+    options.settings.thread_count = get_hardware_thread_count();
+    bool has_manifest = false;
+    for(i32 i = 1; i < argc; ++i) {
+        String_View const argument{argv[i]};
+        if(argument == u8"--manifest" && i + 1 < argc) {
+            i += 1;
+            options.manifest_path = String{argv[i]};
+            has_manifest = true;
+        } else if(argument == u8"--states" && i + 1 < argc) {
+            i += 1;
+            options.states_path = String{argv[i]};
+        } else if(argument == u8"--threads" && i + 1 < argc) {
+            i += 1;
+            options.settings.thread_count = math::max((i32)str_to_i64(argv[i]), 1);
+        } else if(argument == u8"--timestep" && i + 1 < argc) {
+            i += 1;
+            options.settings.timestep = str_to_f32(argv[i]);
+            if(!(options.settings.timestep > 0.0f)) {
+                cout.write(format(u8"timestep must be greater than 0, got {}\n", argv[i]));
+                return false;
+            }
+        } else if(argument == u8"--softening" && i + 1 < argc) {
+            i += 1;
+            if(!parse_softening(argv[i], options.settings.softening)) {
+                cout.write(format(u8"unknown softening {}\n", argv[i]));
+                return false;
+            }
+        } else if(argument == u8"--softening-length" && i + 1 < argc) {
+            i += 1;
+            options.settings.softening_length = math::max(str_to_f32(argv[i]), 1e-3f);
+        } else if(argument == u8"--duration" && i + 1 < argc) {
+            i += 1;
+            options.max_time = str_to_f32(argv[i]);
+        } else if(argument == u8"--collision-distance" && i + 1 < argc) {
+            i += 1;
+            options.collision_distance = str_to_f32(argv[i]);
+        } else if(argument == u8"--escape-distance" && i + 1 < argc) {
+            i += 1;
+            options.escape_distance = str_to_f32(argv[i]);
+        } else {
+            cout.write(format(u8"unknown or incomplete option {}\n", argument));
+            return false;
+        }
+    }
+
+    if(!has_manifest) {
+        cout.write(u8"usage: gravity_simulation_ensemble --manifest <file> [--states <file>] [--threads <count>] [--timestep <seconds>]\n"
+                   u8"                                   [--softening <plummer|spline>] [--softening-length <m>]\n"
+                   u8"                                   [--duration <seconds>] [--collision-distance <m>] [--escape-distance <m>]\n");
+        return false;
+    }
+    return true;
+}
+
+static Array<Point_Mass> const& get_scene(Array<Loaded_Scene>& scenes, String const& path) {
+    for(Loaded_Scene const& scene: scenes) {
+        if(scene.path == path) {
+            return scene.point_masses;
+        }
+    }
+
+    Loaded_Scene& scene = scenes.emplace_back(Loaded_Scene{path, load_point_masses_from_file(path)});
+    return scene.point_masses;
+}
+
+// parse_manifest
+// Every line of the manifest is a member in the format
+// scene, velocity scale, mass scale, max time, collision distance, escape distance
+// where scene is a csv file in the format of load_point_masses_from_file. All fields
+// but the scene are optional and default to 1, 1 and the command line options.
+// Empty lines and lines starting with # are skipped.
+//
+static Array<Ensemble_Member> parse_manifest(Runner_Options const& options) {
+    String const contents = read_file(options.manifest_path);
+    Array<Loaded_Scene> scenes;
+    Array<Ensemble_Member> members;
+    char const* begin = contents.bytes_begin();
+    char const* const end = contents.bytes_end();
+    while(begin != end) {
+        char const* line_end = begin;
+        while(line_end != end && *line_end != '\n') {
+            ++line_end;
+        }
+
+        Array<String> fields;
+        char const* field_begin = begin;
+        for(char const* i = begin;; ++i) {
+            if(i == line_end || *i == ',') {
+                char const* first = field_begin;
+                char const* last = i;
+                while(first != last && (*first == ' ' || *first == '\t')) {
+                    ++first;
+                }
+
+                while(last != first && (*(last - 1) == ' ' || *(last - 1) == '\t' || *(last - 1) == '\r')) {
+                    --last;
+                }
+
+                fields.emplace_back(first, last);
+                if(i == line_end) {
+                    break;
+                }
+                field_begin = i + 1;
+            }
+        }
+
+        begin = line_end;
+        if(begin != end) {
+            ++begin;
+        }
+
+        String const& scene_path = fields[0];
+        if(scene_path.size_bytes() == 0 || *scene_path.bytes_begin() == '#') {
+            continue;
+        }
+
+        f32 const velocity_scale = fields.size() > 1 ? str_to_f32(fields[1]) : 1.0f;
+        f32 const mass_scale = fields.size() > 2 ? str_to_f32(fields[2]) : 1.0f;
+        Ensemble_Member& member = members.emplace_back();
+        member.point_masses = get_scene(scenes, scene_path);
+        member.max_time = fields.size() > 3 ? str_to_f32(fields[3]) : options.max_time;
+        member.collision_distance = fields.size() > 4 ? str_to_f32(fields[4]) : options.collision_distance;
+        member.escape_distance = fields.size() > 5 ? str_to_f32(fields[5]) : options.escape_distance;
+        for(Point_Mass& point_mass: member.point_masses) {
+            point_mass.velocity *= velocity_scale;
+            point_mass.mass *= mass_scale;
+        }
+    }
+    return members;
+}
+
+int main(int argc, char** argv) {
+    Runner_Options options;
+    if(!parse_options(argc, argv, options)) {
+        return -1;
+    }
+
+    Console_Output cout;
+    Array<Ensemble_Member> const members = parse_manifest(options);
+    Array<Ensemble_Result> results;
+    results.resize(members.size());
+    f64 const begin = get_time_ms();
+    run_ensemble(Slice<Ensemble_Member const>{members.begin(), members.end()}, options.settings, Slice<Ensemble_Result>{results.begin(), results.end()});
+    f64 const run_time = get_time_ms() - begin;
+
+    i64 total_steps = 0;
+    for(Ensemble_Result const& result: results) {
+        total_steps += result.steps;
+    }
+
+    cout.write(format(u8"# members={} threads={} timestep={} run_time_ms={} member_steps={}\n", members.size(), options.settings.thread_count,
+                      options.settings.timestep, run_time, total_steps));
+    cout.write(u8"member,stop_reason,time,steps,closest_approach,energy_drift\n");
+    for(i64 i = 0; i < results.size(); ++i) {
+        Ensemble_Result const& result = results[i];
+        cout.write(format(u8"{},{},{},{},{},{}\n", i, stringify(result.stop_reason), result.time, result.steps, result.closest_approach, result.energy_drift));
+    }
+
+    if(options.states_path.size_bytes() > 0) {
+        // The final states in the scene format prefixed with the member index.
+        String states;
+        for(i64 i = 0; i < results.size(); ++i) {
+            for(Point_Mass const& point_mass: results[i].point_masses) {
+                states.append(format(u8"{}, {}, {}, {}, {}, {}\n", i, point_mass.position.x, point_mass.position.y, point_mass.velocity.x,
+                                     point_mass.velocity.y, point_mass.mass));
+            }
+        }
+
+        fs::Output_File_Stream stream;
+        if(!stream.open(options.states_path)) {
+            cout.write(format(u8"failed to open {}\n", options.states_path));
+            return -1;
+        }
+        stream.write(states.data(), states.size_bytes());
+        stream.close();
+    }
+
+    return 0;
+}
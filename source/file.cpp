@@ -0,0 +1,16 @@
+#include <file.hpp>
+
+#include <anton/assert.hpp>
+#include <anton/filesystem.hpp>
+
+String read_file(String const& path) {
+    fs::Input_File_Stream stream(path);
+    ANTON_FAIL(stream, "could not open file for reading");
+    stream.seek(Seek_Dir::end, 0);
+    i64 size = stream.tell();
+    stream.seek(Seek_Dir::beg, 0);
+    String result{reserve, size};
+    result.force_size(size);
+    stream.read(result.data(), size);
+    return result;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <anton/string.hpp>
+#include <build.hpp>
+
+// read_file
+// Reads the whole file into a string. Fails if the file cannot be opened.
+//
+[[nodiscard]] String read_file(String const& path);
@@ -0,0 +1,369 @@
+#include <frame_encoder.hpp>
+
+#include <allocation_tracking.hpp>
+#include <anton/filesystem.hpp>
+#include <trace.hpp>
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+struct Frame_Job {
+    i64 index;
+    i32 width;
+    i32 height;
+    Array<u8> pixels;
+};
+
+struct Frame_Encoder {
+    String directory;
+    Frame_Format format;
+    std::mutex mutex;
+    std::condition_variable job_available;
+    std::condition_variable buffer_available;
+    // The order in which the frames are encoded does not matter.
+    Array<Frame_Job> jobs;
+    Array<Array<u8>> free_buffers;
+    Array<std::thread*> workers;
+    i64 max_pending_frames;
+    // Buffers acquired and not yet encoded.
+    i64 pending_frames = 0;
+    bool stopping = false;
+    bool failed = false;
+};
+
+bool parse_frame_format(String_View const name, Frame_Format& format) {
+    if(name == u8"png") {
+        format = Frame_Format::png;
+    } else if(name == u8"raw") {
+        format = Frame_Format::raw;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+struct Bit_Writer {
+    Array<u8>& output;
+    u64 buffer = 0;
+    i32 bit_count = 0;
+
+    // Deflate packs the bits starting from the least significant bit.
+    void write(u32 const bits, i32 const count) {
+        buffer |= (u64)bits << bit_count;
+        bit_count += count;
+        while(bit_count >= 8) {
+            output.emplace_back((u8)buffer);
+            buffer >>= 8;
+            bit_count -= 8;
+        }
+    }
+
+    void flush() {
+        if(bit_count > 0) {
+            output.emplace_back((u8)buffer);
+        }
+        buffer = 0;
+        bit_count = 0;
+    }
+};
+
+// Huffman codes are stored starting from the most significant bit.
+static u32 reverse_bits(u32 code, i32 const length) {
+    u32 result = 0;
+    for(i32 i = 0; i < length; ++i) {
+        result = (result << 1) | (code & 1);
+        code >>= 1;
+    }
+    return result;
+}
+
+// Writes a literal/length symbol with the fixed Huffman code.
+static void write_fixed_symbol(Bit_Writer& writer, i32 const symbol) {
+    if(symbol <= 143) {
+        writer.write(reverse_bits(0x30 + symbol, 8), 8);
+    } else if(symbol <= 255) {
+        writer.write(reverse_bits(0x190 + symbol - 144, 9), 9);
+    } else if(symbol <= 279) {
+        writer.write(reverse_bits(symbol - 256, 7), 7);
+    } else {
+        writer.write(reverse_bits(0xC0 + symbol - 280, 8), 8);
+    }
+}
+
+constexpr i32 length_bases[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr i32 length_extra_bits[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr i32 distance_bases[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,   33,   49,   65,   97,   129,
+                                    193,  257,  385,  513,  769,  1025,  1537,  2049,  3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr i32 distance_extra_bits[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+constexpr i32 max_match_length = 258;
+constexpr i32 window_size = 32768;
+constexpr i32 hash_bits = 15;
+
+static void write_match(Bit_Writer& writer, i32 const length, i32 const distance) {
+    i32 length_code = 28;
+    while(length_bases[length_code] > length) {
+        --length_code;
+    }
+    write_fixed_symbol(writer, 257 + length_code);
+    writer.write(length - length_bases[length_code], length_extra_bits[length_code]);
+
+    i32 distance_code = 29;
+    while(distance_bases[distance_code] > distance) {
+        --distance_code;
+    }
+    writer.write(reverse_bits(distance_code, 5), 5);
+    writer.write(distance - distance_bases[distance_code], distance_extra_bits[distance_code]);
+}
+
+static u32 hash3(u8 const* const data) {
+    u32 const value = (u32)data[0] | ((u32)data[1] << 8) | ((u32)data[2] << 16);
+    return (value * 2654435761u) >> (32 - hash_bits);
+}
+
+// A single deflate block with the fixed Huffman codes. Greedy LZ77 that tries only
+// the most recent position with the same hash. Rendered frames are mostly uniform,
+// hence long matches are cheap to find.
+static void deflate_fixed(u8 const* const data, i64 const size, Array<u8>& output) {
+    Array<i64> head;
+    head.resize((i64)1 << hash_bits);
+    for(i64& position: head) {
+        position = -1;
+    }
+
+    Bit_Writer writer{output};
+    // BFINAL and BTYPE = fixed Huffman codes.
+    writer.write(1, 1);
+    writer.write(1, 2);
+    i64 i = 0;
+    while(i < size) {
+        i32 match_length = 0;
+        i64 match_distance = 0;
+        if(i + 3 <= size) {
+            u32 const hash = hash3(data + i);
+            i64 const candidate = head[hash];
+            head[hash] = i;
+            if(candidate >= 0 && i - candidate <= window_size) {
+                i64 const max_length = math::min((i64)max_match_length, size - i);
+                i32 length = 0;
+                while(length < max_length && data[candidate + length] == data[i + length]) {
+                    ++length;
+                }
+
+                if(length >= 3) {
+                    match_length = length;
+                    match_distance = i - candidate;
+                }
+            }
+        }
+
+        if(match_length > 0) {
+            write_match(writer, match_length, (i32)match_distance);
+            for(i64 k = i + 1; k < i + match_length && k + 3 <= size; ++k) {
+                head[hash3(data + k)] = k;
+            }
+            i += match_length;
+        } else {
+            write_fixed_symbol(writer, data[i]);
+            i += 1;
+        }
+    }
+
+    write_fixed_symbol(writer, 256);
+    writer.flush();
+}
+
+static u32 crc32(u8 const* const data, i64 const size, u32 crc = 0) {
+    static u32 table[256] = {};
+    static bool const initialized = [] {
+        for(u32 n = 0; n < 256; ++n) {
+            u32 c = n;
+            for(i32 k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        return true;
+    }();
+    (void)initialized;
+
+    crc = ~crc;
+    for(i64 i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static u32 adler32(u8 const* const data, i64 const size) {
+    u32 a = 1;
+    u32 b = 0;
+    for(i64 i = 0; i < size; ++i) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+static void append_u32_big_endian(Array<u8>& output, u32 const value) {
+    output.emplace_back((u8)(value >> 24));
+    output.emplace_back((u8)(value >> 16));
+    output.emplace_back((u8)(value >> 8));
+    output.emplace_back((u8)value);
+}
+
+static void append_chunk(Array<u8>& output, char const* const type, u8 const* const data, i64 const size) {
+    append_u32_big_endian(output, (u32)size);
+    i64 const type_offset = output.size();
+    for(i32 i = 0; i < 4; ++i) {
+        output.emplace_back((u8)type[i]);
+    }
+    for(i64 i = 0; i < size; ++i) {
+        output.emplace_back(data[i]);
+    }
+    append_u32_big_endian(output, crc32(output.data() + type_offset, size + 4));
+}
+
+void encode_png(u8 const* const pixels, i32 const width, i32 const height, Array<u8>& output) {
+    TRACE_ZONE("encode_png");
+    // Every row is preceded by the filter type 0 and the rows go from the top.
+    i64 const row_size = (i64)width * 4;
+    Array<u8> filtered;
+    filtered.resize((row_size + 1) * height);
+    for(i32 y = 0; y < height; ++y) {
+        u8* const row = filtered.data() + (row_size + 1) * y;
+        u8 const* const source = pixels + row_size * (height - 1 - y);
+        row[0] = 0;
+        for(i64 i = 0; i < row_size; ++i) {
+            row[i + 1] = source[i];
+        }
+    }
+
+    Array<u8> compressed;
+    // zlib header. Deflate with a 32K window and no dictionary.
+    compressed.emplace_back(0x78);
+    compressed.emplace_back(0x01);
+    deflate_fixed(filtered.data(), filtered.size(), compressed);
+    append_u32_big_endian(compressed, adler32(filtered.data(), filtered.size()));
+
+    u8 const signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    output.clear();
+    for(u8 const byte: signature) {
+        output.emplace_back(byte);
+    }
+
+    Array<u8> header;
+    append_u32_big_endian(header, (u32)width);
+    append_u32_big_endian(header, (u32)height);
+    // 8 bit depth, rgba, deflate, adaptive filtering, no interlacing.
+    header.emplace_back(8);
+    header.emplace_back(6);
+    header.emplace_back(0);
+    header.emplace_back(0);
+    header.emplace_back(0);
+    append_chunk(output, "IHDR", header.data(), header.size());
+    append_chunk(output, "IDAT", compressed.data(), compressed.size());
+    append_chunk(output, "IEND", nullptr, 0);
+}
+
+static bool write_frame(Frame_Encoder const& encoder, Frame_Job const& job, Array<u8>& scratch) {
+    TRACE_ZONE("write_frame");
+    char name[64];
+    if(encoder.format == Frame_Format::png) {
+        encode_png(job.pixels.data(), job.width, job.height, scratch);
+        snprintf(name, sizeof(name), "/frame_%06lld.png", (long long)job.index);
+    } else {
+        // Flip the rows so that they go from the top.
+        i64 const row_size = (i64)job.width * 4;
+        scratch.resize(row_size * job.height);
+        for(i32 y = 0; y < job.height; ++y) {
+            u8 const* const source = job.pixels.data() + row_size * (job.height - 1 - y);
+            u8* const destination = scratch.data() + row_size * y;
+            for(i64 i = 0; i < row_size; ++i) {
+                destination[i] = source[i];
+            }
+        }
+        snprintf(name, sizeof(name), "/frame_%06lld.rgba", (long long)job.index);
+    }
+
+    fs::Output_File_Stream stream;
+    if(!stream.open(encoder.directory + name)) {
+        return false;
+    }
+    stream.write(scratch.data(), scratch.size());
+    stream.close();
+    return true;
+}
+
+static void worker_main(Frame_Encoder& encoder) {
+    ALLOCATION_SCOPE(Allocation_Tag::encoder);
+    Array<u8> scratch;
+    std::unique_lock<std::mutex> lock{encoder.mutex};
+    while(true) {
+        encoder.job_available.wait(lock, [&encoder] { return encoder.jobs.size() > 0 || encoder.stopping; });
+        if(encoder.jobs.size() == 0) {
+            return;
+        }
+
+        Frame_Job job = ANTON_MOV(encoder.jobs.back());
+        encoder.jobs.pop_back();
+        lock.unlock();
+        bool const written = write_frame(encoder, job, scratch);
+        lock.lock();
+        encoder.failed = encoder.failed || !written;
+        encoder.free_buffers.emplace_back(ANTON_MOV(job.pixels));
+        encoder.pending_frames -= 1;
+        encoder.buffer_available.notify_one();
+    }
+}
+
+Frame_Encoder* create_frame_encoder(String const& directory, Frame_Format const format, i32 const thread_count, i64 const max_pending_frames) {
+    Frame_Encoder* const encoder = new Frame_Encoder;
+    encoder->directory = directory;
+    encoder->format = format;
+    encoder->max_pending_frames = math::max(max_pending_frames, (i64)1);
+    for(i32 i = 0; i < math::max(thread_count, 1); ++i) {
+        encoder->workers.emplace_back(new std::thread(worker_main, std::ref(*encoder)));
+    }
+    return encoder;
+}
+
+bool destroy_frame_encoder(Frame_Encoder* const encoder) {
+    {
+        std::lock_guard<std::mutex> lock{encoder->mutex};
+        encoder->stopping = true;
+    }
+    encoder->job_available.notify_all();
+    for(std::thread* const worker: encoder->workers) {
+        worker->join();
+        delete worker;
+    }
+
+    bool const succeeded = !encoder->failed;
+    delete encoder;
+    return succeeded;
+}
+
+Array<u8> acquire_frame_buffer(Frame_Encoder& encoder, i32 const width, i32 const height) {
+    TRACE_ZONE("acquire_frame_buffer");
+    Array<u8> buffer;
+    {
+        std::unique_lock<std::mutex> lock{encoder.mutex};
+        encoder.buffer_available.wait(lock, [&encoder] { return encoder.pending_frames < encoder.max_pending_frames; });
+        encoder.pending_frames += 1;
+        if(encoder.free_buffers.size() > 0) {
+            buffer = ANTON_MOV(encoder.free_buffers.back());
+            encoder.free_buffers.pop_back();
+        }
+    }
+    buffer.resize((i64)width * height * 4);
+    return buffer;
+}
+
+void submit_frame(Frame_Encoder& encoder, i64 const index, i32 const width, i32 const height, Array<u8>&& pixels) {
+    {
+        std::lock_guard<std::mutex> lock{encoder.mutex};
+        encoder.jobs.emplace_back(Frame_Job{index, width, height, ANTON_MOV(pixels)});
+    }
+    encoder.job_available.notify_one();
+}
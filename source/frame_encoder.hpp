@@ -0,0 +1,55 @@
+#pragma once
+
+#include <anton/array.hpp>
+#include <anton/string.hpp>
+#include <anton/string_view.hpp>
+#include <build.hpp>
+
+enum struct Frame_Format {
+    // frame_<index>.png
+    png,
+    // frame_<index>.rgba, 8 bit rgba rows from the top without a header.
+    raw,
+};
+
+struct Frame_Encoder;
+
+// parse_frame_format
+//
+// Returns:
+// true if name is one of png or raw.
+//
+[[nodiscard]] bool parse_frame_format(String_View name, Frame_Format& format);
+
+// create_frame_encoder
+// Starts thread_count threads that encode the submitted frames and write them to directory.
+// At most max_pending_frames frames are buffered. Submitting more blocks.
+//
+[[nodiscard]] Frame_Encoder* create_frame_encoder(String const& directory, Frame_Format format, i32 thread_count, i64 max_pending_frames);
+
+// destroy_frame_encoder
+// Waits until every submitted frame has been written and stops the threads.
+//
+// Returns:
+// false if any frame could not be written.
+//
+bool destroy_frame_encoder(Frame_Encoder* encoder);
+
+// acquire_frame_buffer
+// Returns a buffer of width * height * 4 bytes for the next frame. The buffers are recycled.
+// Blocks while max_pending_frames frames are waiting to be encoded.
+//
+[[nodiscard]] Array<u8> acquire_frame_buffer(Frame_Encoder& encoder, i32 width, i32 height);
+
+// submit_frame
+// Queues the frame for encoding.
+//
+// Parameters:
+// pixels - 8 bit rgba rows from the bottom as returned by glReadPixels.
+//
+void submit_frame(Frame_Encoder& encoder, i64 index, i32 width, i32 height, Array<u8>&& pixels);
+
+// encode_png
+// Encodes 8 bit rgba rows from the bottom as a png compressed with fixed Huffman codes.
+//
+void encode_png(u8 const* pixels, i32 width, i32 height, Array<u8>& output);
@@ -0,0 +1,303 @@
+#include <generators.hpp>
+
+#include <anton/array.hpp>
+#include <point_mass.hpp>
+#include <threads.hpp>
+#include <trace.hpp>
+#include <tracer.hpp>
+#include <transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+constexpr f64 gravitational_constant_f64 = 6.67408e-11;
+// math::pi is only single precision.
+constexpr f64 pi_f64 = 3.14159265358979323846;
+// Bodies are generated in chunks with independent random streams.
+// The chunk size must never depend on the thread count.
+constexpr i64 generator_chunk_size = 4096;
+// Total mass and scale length of the disks and clusters.
+constexpr f64 cluster_mass = 1.0e21;
+constexpr f64 cluster_radius = 1.0e5;
+constexpr f64 cluster_scale_length = 2.5e4;
+// Star-planet systems.
+constexpr i64 planets_per_system = 4;
+constexpr f64 star_mass = 4.0e24;
+constexpr f64 innermost_orbit = 1.0e6;
+constexpr f64 orbit_spacing_ratio = 1.8;
+constexpr f64 system_spacing = 2.0e8;
+// Tracers are placed between these fractions of the extent of the point masses.
+constexpr f64 tracer_inner_radius = 0.05;
+constexpr f64 tracer_outer_radius = 1.5;
+
+struct Random {
+    u64 state;
+
+    // splitmix64
+    u64 next_u64() {
+        state += 0x9E3779B97F4A7C15ULL;
+        u64 z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, 1).
+    f64 next_f64() {
+        return (f64)(next_u64() >> 11) * 0x1.0p-53;
+    }
+};
+
+static Random make_stream(u64 const seed, u64 const stream) {
+    Random random{seed ^ (stream * 0xD1B54A32D192ED03ULL)};
+    // Decorrelate neighbouring streams.
+    random.next_u64();
+    return random;
+}
+
+static Vec2 polar(f64 const radius, f64 const angle) {
+    return Vec2{(f32)(radius * std::cos(angle)), (f32)(radius * std::sin(angle))};
+}
+
+// Velocity of a counterclockwise circular orbit at position around the origin
+// given the mass enclosed by the orbit.
+static Vec2 circular_velocity(f64 const radius, f64 const angle, f64 const enclosed_mass) {
+    if(radius <= 0.0) {
+        return Vec2{0.0f, 0.0f};
+    }
+
+    f64 const speed = std::sqrt(gravitational_constant_f64 * enclosed_mass / radius);
+    return polar(speed, angle + 0.5 * pi_f64);
+}
+
+static Point_Mass generate_uniform_disk(Random& random, f64 const body_mass) {
+    f64 const radius = cluster_radius * std::sqrt(random.next_f64());
+    f64 const angle = 2.0 * pi_f64 * random.next_f64();
+    return Point_Mass{polar(radius, angle), Vec2{0.0f, 0.0f}, (f32)body_mass};
+}
+
+static Point_Mass generate_exponential_disk(Random& random, f64 const body_mass) {
+    // Invert the enclosed mass fraction 1 - (1 + x)e^-x by bisection. Truncated at 99.9% of the mass.
+    f64 const u = 0.999 * random.next_f64();
+    f64 low = 0.0;
+    f64 high = 16.0;
+    for(i32 i = 0; i < 48; ++i) {
+        f64 const x = 0.5 * (low + high);
+        if(1.0 - (1.0 + x) * std::exp(-x) < u) {
+            low = x;
+        } else {
+            high = x;
+        }
+    }
+
+    f64 const x = 0.5 * (low + high);
+    f64 const radius = cluster_scale_length * x;
+    f64 const angle = 2.0 * pi_f64 * random.next_f64();
+    // The enclosed mass is treated as if it were spherically distributed.
+    f64 const enclosed_mass = cluster_mass * (1.0 - (1.0 + x) * std::exp(-x));
+    return Point_Mass{polar(radius, angle), circular_velocity(radius, angle, enclosed_mass), (f32)body_mass};
+}
+
+static Point_Mass generate_kuzmin_disk(Random& random, f64 const body_mass) {
+    // Enclosed mass fraction is 1 - a / sqrt(r^2 + a^2). Truncated at 99% of the mass.
+    f64 const u = 0.99 * random.next_f64();
+    f64 const a = cluster_scale_length;
+    f64 const radius = a * std::sqrt(1.0 / ((1.0 - u) * (1.0 - u)) - 1.0);
+    f64 const angle = 2.0 * pi_f64 * random.next_f64();
+    // v^2 = G M r^2 / (r^2 + a^2)^(3/2)
+    f64 const r2a2 = radius * radius + a * a;
+    f64 const speed = std::sqrt(gravitational_constant_f64 * cluster_mass * radius * radius / (r2a2 * std::sqrt(r2a2)));
+    return Point_Mass{polar(radius, angle), polar(speed, angle + 0.5 * pi_f64), (f32)body_mass};
+}
+
+static Point_Mass generate_plummer(Random& random, f64 const body_mass) {
+    f64 const a = cluster_scale_length;
+    // Truncated at 99.9% of the mass.
+    f64 const u = 1.0e-10 + 0.999 * random.next_f64();
+    f64 const radius = a / std::sqrt(std::pow(u, -2.0 / 3.0) - 1.0);
+    f64 const angle = 2.0 * pi_f64 * random.next_f64();
+    // Aarseth, Henon and Wielen rejection sampling of q = v / v_escape from q^2 (1 - q^2)^(7/2).
+    f64 q = 0.0;
+    while(true) {
+        q = random.next_f64();
+        f64 const g = q * q * std::pow(1.0 - q * q, 3.5);
+        if(0.1 * random.next_f64() < g) {
+            break;
+        }
+    }
+
+    f64 const escape_speed = std::sqrt(2.0 * gravitational_constant_f64 * cluster_mass / a) * std::pow(1.0 + radius * radius / (a * a), -0.25);
+    f64 const direction = 2.0 * pi_f64 * random.next_f64();
+    return Point_Mass{polar(radius, angle), polar(q * escape_speed, direction), (f32)body_mass};
+}
+
+// Body index in a system 0 is the star, the rest are the planets.
+static Point_Mass generate_star_planet(Random& random, i64 const index_in_system, Vec2 const system_position) {
+    if(index_in_system == 0) {
+        return Point_Mass{system_position, Vec2{0.0f, 0.0f}, (f32)star_mass};
+    }
+
+    f64 const radius = innermost_orbit * std::pow(orbit_spacing_ratio, (f64)(index_in_system - 1));
+    f64 const angle = 2.0 * pi_f64 * random.next_f64();
+    f64 const mass = 1.0e14 * (1.0 + 9.0 * random.next_f64());
+    return Point_Mass{system_position + polar(radius, angle), circular_velocity(radius, angle, star_mass), (f32)mass};
+}
+
+static void generate_chunk(Generator_Settings const& settings, Slice<Point_Mass> const point_masses, i64 const begin, i64 const end) {
+    f64 const body_mass = cluster_mass / (f64)settings.count;
+    Random random = make_stream(settings.seed, begin / generator_chunk_size);
+    switch(settings.kind) {
+        case Generator_Kind::uniform_disk: {
+            for(i64 i = begin; i < end; ++i) {
+                point_masses[i] = generate_uniform_disk(random, body_mass);
+            }
+        } break;
+
+        case Generator_Kind::exponential_disk: {
+            for(i64 i = begin; i < end; ++i) {
+                point_masses[i] = generate_exponential_disk(random, body_mass);
+            }
+        } break;
+
+        case Generator_Kind::kuzmin_disk: {
+            for(i64 i = begin; i < end; ++i) {
+                point_masses[i] = generate_kuzmin_disk(random, body_mass);
+            }
+        } break;
+
+        case Generator_Kind::plummer: {
+            for(i64 i = begin; i < end; ++i) {
+                point_masses[i] = generate_plummer(random, body_mass);
+            }
+        } break;
+
+        case Generator_Kind::star_planet: {
+            // Every system has its own stream so that systems never straddle two streams.
+            i64 const system_size = planets_per_system + 1;
+            i64 const system_count = (settings.count + system_size - 1) / system_size;
+            i64 const systems_per_row = (i64)std::ceil(std::sqrt((f64)system_count));
+            for(i64 i = begin; i < end; ++i) {
+                i64 const system = i / system_size;
+                i64 const index_in_system = i % system_size;
+                Random system_random = make_stream(settings.seed, system);
+                // Jitter the systems on a grid so that they never overlap.
+                f64 const x = ((f64)(system % systems_per_row) + 0.5 * system_random.next_f64()) * system_spacing;
+                f64 const y = ((f64)(system / systems_per_row) + 0.5 * system_random.next_f64()) * system_spacing;
+                // Skip the numbers consumed by the preceding bodies of the system.
+                for(i64 j = 1; j < index_in_system; ++j) {
+                    system_random.next_u64();
+                    system_random.next_u64();
+                }
+                point_masses[i] = generate_star_planet(system_random, index_in_system, Vec2{(f32)x, (f32)y});
+            }
+        } break;
+    }
+}
+
+bool parse_generator_kind(String_View const name, Generator_Kind& kind) {
+    if(name == u8"uniform_disk") {
+        kind = Generator_Kind::uniform_disk;
+    } else if(name == u8"exponential_disk") {
+        kind = Generator_Kind::exponential_disk;
+    } else if(name == u8"kuzmin_disk") {
+        kind = Generator_Kind::kuzmin_disk;
+    } else if(name == u8"plummer") {
+        kind = Generator_Kind::plummer;
+    } else if(name == u8"star_planet") {
+        kind = Generator_Kind::star_planet;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void generate_scene(World& world, Generator_Settings const& settings) {
+    TRACE_ZONE("generate_scene");
+    Array<Point_Mass> point_masses;
+    point_masses.resize(settings.count);
+    Slice<Point_Mass> const point_masses_slice{point_masses.begin(), point_masses.end()};
+    parallel_for(settings.count, generator_chunk_size, settings.thread_count,
+                 [&settings, point_masses_slice](i64 const begin, i64 const end) { generate_chunk(settings, point_masses_slice, begin, end); });
+
+    for(Point_Mass const& point_mass: point_masses) {
+        Entity const e = world.create();
+        world.add_component(e, point_mass);
+        world.add_component(e, Transform{});
+    }
+}
+
+// Mass enclosed by a circle of radius around the center of mass.
+struct Enclosed_Mass {
+    f64 radius;
+    f64 mass;
+};
+
+void generate_tracers(World& world, i64 const count, u64 const seed, i32 const thread_count) {
+    TRACE_ZONE("generate_tracers");
+    Slice<Point_Mass> const point_masses = world.components<Point_Mass>();
+    f64 total_mass = 0.0;
+    f64 center_x = 0.0;
+    f64 center_y = 0.0;
+    f64 momentum_x = 0.0;
+    f64 momentum_y = 0.0;
+    for(Point_Mass const& point_mass: point_masses) {
+        total_mass += point_mass.mass;
+        center_x += (f64)point_mass.position.x * point_mass.mass;
+        center_y += (f64)point_mass.position.y * point_mass.mass;
+        momentum_x += (f64)point_mass.velocity.x * point_mass.mass;
+        momentum_y += (f64)point_mass.velocity.y * point_mass.mass;
+    }
+
+    if(total_mass > 0.0) {
+        center_x /= total_mass;
+        center_y /= total_mass;
+        momentum_x /= total_mass;
+        momentum_y /= total_mass;
+    }
+
+    // Sorted by distance from the center of mass.
+    Array<Enclosed_Mass> enclosed_masses;
+    for(Point_Mass const& point_mass: point_masses) {
+        f64 const dx = point_mass.position.x - center_x;
+        f64 const dy = point_mass.position.y - center_y;
+        enclosed_masses.emplace_back(Enclosed_Mass{std::sqrt(dx * dx + dy * dy), point_mass.mass});
+    }
+
+    std::sort(enclosed_masses.begin(), enclosed_masses.end(), [](Enclosed_Mass const& lhs, Enclosed_Mass const& rhs) { return lhs.radius < rhs.radius; });
+    f64 mass_sum = 0.0;
+    for(Enclosed_Mass& enclosed_mass: enclosed_masses) {
+        mass_sum += enclosed_mass.mass;
+        enclosed_mass.mass = mass_sum;
+    }
+
+    f64 const extent = enclosed_masses.size() > 0 && enclosed_masses.back().radius > 0.0 ? enclosed_masses.back().radius : innermost_orbit;
+    f64 const inner_radius = tracer_inner_radius * extent;
+    f64 const outer_radius = tracer_outer_radius * extent;
+
+    Tracer_Cloud cloud;
+    cloud.position_x.resize(count);
+    cloud.position_y.resize(count);
+    cloud.velocity_x.resize(count);
+    cloud.velocity_y.resize(count);
+    parallel_for(count, generator_chunk_size, thread_count, [&](i64 const begin, i64 const end) {
+        Random random = make_stream(seed, begin / generator_chunk_size);
+        for(i64 i = begin; i < end; ++i) {
+            // Uniform in area.
+            f64 const u = random.next_f64();
+            f64 const radius = std::sqrt(inner_radius * inner_radius + u * (outer_radius * outer_radius - inner_radius * inner_radius));
+            f64 const angle = 2.0 * pi_f64 * random.next_f64();
+            auto const enclosed = std::upper_bound(enclosed_masses.begin(), enclosed_masses.end(), radius,
+                                                   [](f64 const value, Enclosed_Mass const& enclosed_mass) { return value < enclosed_mass.radius; });
+            f64 const mass = enclosed != enclosed_masses.begin() ? (enclosed - 1)->mass : 0.0;
+            Vec2 const position = polar(radius, angle);
+            Vec2 const velocity = circular_velocity(radius, angle, mass);
+            cloud.position_x[i] = (f32)(center_x + position.x);
+            cloud.position_y[i] = (f32)(center_y + position.y);
+            cloud.velocity_x[i] = (f32)(momentum_x + velocity.x);
+            cloud.velocity_y[i] = (f32)(momentum_y + velocity.y);
+        }
+    });
+
+    Entity const e = world.create();
+    world.add_component(e, cloud);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <anton/string_view.hpp>
+#include <build.hpp>
+#include <world.hpp>
+
+enum struct Generator_Kind {
+    // Bodies of equal mass uniformly distributed in a disk, initially at rest.
+    uniform_disk,
+    // Exponential surface density with circular velocities.
+    exponential_disk,
+    // Kuzmin surface density with circular velocities.
+    kuzmin_disk,
+    // Plummer radial profile with isotropic velocities drawn from the Plummer distribution function.
+    plummer,
+    // Stars with planets on circular orbits like examples/planet_star.txt.
+    star_planet,
+};
+
+struct Generator_Settings {
+    Generator_Kind kind = Generator_Kind::uniform_disk;
+    i64 count = 1000;
+    u64 seed = 0;
+    // Maximum number of threads used to generate the bodies. Does not affect the output.
+    i32 thread_count = 1;
+};
+
+// parse_generator_kind
+//
+// Returns:
+// true if name is one of uniform_disk, exponential_disk, kuzmin_disk, plummer or star_planet.
+//
+[[nodiscard]] bool parse_generator_kind(String_View name, Generator_Kind& kind);
+
+// generate_scene
+// Generates settings.count point masses and adds them to the world as new entities
+// with Point_Mass and Transform components. The output depends only on the kind, count and seed.
+//
+void generate_scene(World& world, Generator_Settings const& settings);
+
+// generate_tracers
+// Adds an entity with a Tracer_Cloud of count tracers on circular orbits around the center
+// of mass of the point masses of the world. The tracers fill an annulus that extends past
+// the farthest point mass. The output depends only on the point masses, count and seed.
+//
+void generate_tracers(World& world, i64 count, u64 seed, i32 thread_count);
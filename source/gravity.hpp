@@ -0,0 +1,100 @@
+#pragma once
+
+#include <anton/math/vec2.hpp>
+#include <build.hpp>
+
+#include <cmath>
+
+constexpr f32 gravitational_constant = 6.67408e-11f;
+
+// Softening of the interactions at short distances. Without it the force diverges as two bodies
+// approach each other. The kernels are branch-free, hence the loops over the sources vectorize,
+// and a body at zero distance from a source, e.g. the source itself, receives no acceleration.
+// The softening length must be greater than 0.
+enum struct Softening {
+    plummer,
+    spline,
+};
+
+// Plummer_Softening
+// Replaces the point masses with Plummer spheres with the scale length h. The force deviates
+// from the Newtonian one at all distances, by about 1.5 (h/r)^2 relatively at distance r.
+//
+struct Plummer_Softening {
+    // get_force_factor
+    // Returns f such that the acceleration exerted by a unit mass separated by d is G f d.
+    //
+    template<typename T>
+    [[nodiscard]] static T get_force_factor(T const distance_squared, T const softening_length) {
+        T const s = distance_squared + softening_length * softening_length;
+        return T(1) / (s * std::sqrt(s));
+    }
+
+    // get_potential
+    // Potential of a unit mass divided by G.
+    //
+    template<typename T>
+    [[nodiscard]] static T get_potential(T const distance_squared, T const softening_length) {
+        return T(-1) / std::sqrt(distance_squared + softening_length * softening_length);
+    }
+};
+
+// Spline_Softening
+// Replaces the point masses with the cubic spline density kernel of Monaghan and Lattanzio with the
+// support radius h. The force is exactly Newtonian beyond h. All pieces of the kernel are evaluated
+// and the result is selected, so that the evaluation does not branch.
+//
+struct Spline_Softening {
+    template<typename T>
+    [[nodiscard]] static T get_force_factor(T const distance_squared, T const softening_length) {
+        T const distance = std::sqrt(distance_squared);
+        T const h = softening_length;
+        T const inverse_h3 = T(1) / (h * h * h);
+        T const u = distance / h;
+        T const inner = inverse_h3 * (T(32.0 / 3.0) + u * u * (T(32) * u - T(38.4)));
+        // Clamped so that the pieces that are not selected remain finite.
+        T const um = u > T(0.5) ? u : T(0.5);
+        T const middle = inverse_h3 * (T(64.0 / 3.0) - T(48) * um + T(38.4) * um * um - T(32.0 / 3.0) * um * um * um - T(1.0 / 15.0) / (um * um * um));
+        T const r = distance > h ? distance : h;
+        T const outer = T(1) / (r * r * r);
+        return u < T(0.5) ? inner : (u < T(1) ? middle : outer);
+    }
+
+    template<typename T>
+    [[nodiscard]] static T get_potential(T const distance_squared, T const softening_length) {
+        T const distance = std::sqrt(distance_squared);
+        T const h = softening_length;
+        T const u = distance / h;
+        T const inner = (T(-2.8) + u * u * (T(16.0 / 3.0) + u * u * (T(6.4) * u - T(9.6)))) / h;
+        T const um = u > T(0.5) ? u : T(0.5);
+        T const middle = (T(-3.2) + T(1.0 / 15.0) / um + um * um * (T(32.0 / 3.0) + um * (T(-16) + um * (T(9.6) - T(32.0 / 15.0) * um)))) / h;
+        T const r = distance > h ? distance : h;
+        T const outer = T(-1) / r;
+        return u < T(0.5) ? inner : (u < T(1) ? middle : outer);
+    }
+};
+
+// with_softening_kernel
+// Calls function with the kernel of softening, so that the kernel is a compile-time policy
+// of the code inside of function while it is selected at runtime once per call.
+//
+template<typename Function>
+decltype(auto) with_softening_kernel(Softening const softening, Function const& function) {
+    switch(softening) {
+        case Softening::plummer:
+            return function(Plummer_Softening{});
+        case Softening::spline:
+            return function(Spline_Softening{});
+    }
+    return function(Plummer_Softening{});
+}
+
+// gravitational_acceleration
+// Acceleration at position exerted by mass located at source_position.
+//
+template<typename Kernel>
+[[nodiscard]] inline Vec2 gravitational_acceleration(Vec2 const source_position, f32 const mass, Vec2 const position, f32 const softening_length) {
+    Vec2 const distance_vec = source_position - position;
+    f32 const factor = Kernel::get_force_factor(math::dot(distance_vec, distance_vec), softening_length);
+    return distance_vec * (gravitational_constant * mass * factor);
+}
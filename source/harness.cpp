@@ -0,0 +1,300 @@
+// Accuracy-versus-cost harness for the force solvers.
+// Runs a scene with the exact direct sum as the reference, sweeps the parameters
+// of the approximate solvers and the timestep, and prints the results as csv.
+
+#include <anton/array.hpp>
+#include <anton/console.hpp>
+#include <anton/format.hpp>
+#include <anton/string.hpp>
+#include <build.hpp>
+#include <generators.hpp>
+#include <physics.hpp>
+#include <point_mass.hpp>
+#include <scene.hpp>
+#include <threads.hpp>
+#include <transform.hpp>
+#include <world.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+struct Solver_Configuration {
+    Force_Solver solver;
+    f32 opening_angle;
+    i32 leaf_size;
+};
+
+constexpr Solver_Configuration solver_configurations[] = {
+    {Force_Solver::direct, 0.0f, 0},
+    {Force_Solver::tree, 0.2f, 4},
+    {Force_Solver::tree, 0.35f, 4},
+    {Force_Solver::tree, 0.5f, 4},
+    {Force_Solver::tree, 0.7f, 4},
+    {Force_Solver::tree, 1.0f, 4},
+    {Force_Solver::tree, 0.35f, 16},
+    {Force_Solver::tree, 0.5f, 16},
+    {Force_Solver::tree, 0.7f, 16},
+    {Force_Solver::tree, 1.0f, 16},
+};
+
+constexpr f32 timesteps[] = {1.0f / 240.0f, 1.0f / 120.0f, 1.0f / 60.0f, 1.0f / 30.0f};
+// Number of force evaluations timed per configuration. The median is reported.
+constexpr i64 timing_repetitions = 3;
+
+struct Harness_Options {
+    String scene_path;
+    bool generate = false;
+    Generator_Settings generator_settings;
+    i32 thread_count = 1;
+    // Integrator of the energy drift runs.
+    Integrator integrator = Integrator::verlet;
+    Softening softening = Softening::spline;
+    f32 softening_length = 1.0f;
+    // Multiplies the swept timesteps.
+    f32 timestep_scale = 1.0f;
+    // Simulated time of the energy drift runs in seconds.
+    f32 duration = 1.0f;
+    // Maximum acceptable 99th percentile of the relative force error. Negative when not set.
+    f64 error_budget = -1.0;
+    // Maximum acceptable relative energy drift over the duration. Applies together with error_budget.
+    f64 drift_budget = 1e-3;
+};
+
+struct Force_Error {
+    f64 rms;
+    f64 p99;
+};
+
+static f64 get_time_ms() {
+    auto const now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<f64, std::milli>(now).count();
+}
+
+static void load_scene(World& world, Harness_Options const& options) {
+    world.register_type<Point_Mass>();
+    world.register_type<Transform>();
+    if(options.generate) {
+        generate_scene(world, options.generator_settings);
+    } else {
+        load_scene_from_file(world, options.scene_path);
+    }
+}
+
+static Slice<Point_Mass const> get_point_masses(World& world) {
+    Slice<Point_Mass> const point_masses = world.components<Point_Mass>();
+    return Slice<Point_Mass const>{point_masses.begin(), point_masses.end()};
+}
+
+static Force_Error compute_force_error(Slice<Vec2 const> const reference, Slice<Vec2 const> const accelerations) {
+    Array<f64> errors{reserve, reference.size()};
+    f64 sum_squared = 0.0;
+    for(i64 i = 0; i < reference.size(); ++i) {
+        f64 const reference_magnitude = math::length(reference[i]);
+        if(reference_magnitude <= 0.0) {
+            continue;
+        }
+
+        f64 const error = math::length(accelerations[i] - reference[i]) / reference_magnitude;
+        errors.emplace_back(error);
+        sum_squared += error * error;
+    }
+
+    if(errors.size() == 0) {
+        return Force_Error{0.0, 0.0};
+    }
+
+    i64 const p99_index = math::min((i64)(0.99 * (f64)errors.size()), errors.size() - 1);
+    std::nth_element(errors.begin(), errors.begin() + p99_index, errors.end());
+    return Force_Error{std::sqrt(sum_squared / (f64)errors.size()), errors[p99_index]};
+}
+
+static bool parse_options(i32 const argc, char** const argv, Harness_Options& options) {
+    Console_Output cout;
+    options.thread_count = get_hardware_thread_count();
+    bool has_scene = false;
+    for(i32 i = 1; i < argc; ++i) {
+        String_View const argument{argv[i]};
+        if(argument == u8"--scene" && i + 1 < argc) {
+            i += 1;
+            options.scene_path = String{argv[i]};
+            has_scene = true;
+        } else if(argument == u8"--generate" && i + 1 < argc) {
+            i += 1;
+            options.generate = true;
+            has_scene = true;
+            if(!parse_generator_kind(argv[i], options.generator_settings.kind)) {
+                cout.write(format(u8"unknown generator {}\n", argv[i]));
+                return false;
+            }
+        } else if(argument == u8"--count" && i + 1 < argc) {
+            i += 1;
+            options.generator_settings.count = math::max(str_to_i64(argv[i]), (i64)0);
+        } else if(argument == u8"--seed" && i + 1 < argc) {
+            i += 1;
+            options.generator_settings.seed = (u64)str_to_i64(argv[i]);
+        } else if(argument == u8"--threads" && i + 1 < argc) {
+            i += 1;
+            options.thread_count = math::max((i32)str_to_i64(argv[i]), 1);
+        } else if(argument == u8"--integrator" && i + 1 < argc) {
+            i += 1;
+            if(!parse_integrator(argv[i], options.integrator)) {
+                cout.write(format(u8"unknown integrator {}\n", argv[i]));
+                return false;
+            }
+        } else if(argument == u8"--softening" && i + 1 < argc) {
+            i += 1;
+            if(!parse_softening(argv[i], options.softening)) {
+                cout.write(format(u8"unknown softening {}\n", argv[i]));
+                return false;
+            }
+        } else if(argument == u8"--softening-length" && i + 1 < argc) {
+            i += 1;
+            options.softening_length = math::max(str_to_f32(argv[i]), 1e-3f);
+        } else if(argument == u8"--timestep-scale" && i + 1 < argc) {
+            i += 1;
+            options.timestep_scale = str_to_f32(argv[i]);
+            if(!(options.timestep_scale > 0.0f)) {
+                cout.write(format(u8"timestep scale must be greater than 0, got {}\n", argv[i]));
+                return false;
+            }
+        } else if(argument == u8"--duration" && i + 1 < argc) {
+            i += 1;
+            options.duration = str_to_f32(argv[i]);
+            if(!(options.duration > 0.0f)) {
+                cout.write(format(u8"duration must be greater than 0, got {}\n", argv[i]));
+                return false;
+            }
+        } else if(argument == u8"--error-budget" && i + 1 < argc) {
+            i += 1;
+            options.error_budget = str_to_f32(argv[i]);
+        } else if(argument == u8"--drift-budget" && i + 1 < argc) {
+            i += 1;
+            options.drift_budget = str_to_f32(argv[i]);
+        } else {
+            cout.write(format(u8"unknown or incomplete option {}\n", argument));
+            return false;
+        }
+    }
+
+    if(!has_scene) {
+        cout.write(u8"usage: gravity_simulation_harness (--scene <file> | --generate <generator> [--count <count>] [--seed <seed>])\n"
+                   u8"                                  [--threads <count>] [--integrator <verlet|wisdom_holman>] [--timestep-scale <factor>]\n"
+                   u8"                                  [--softening <plummer|spline>] [--softening-length <meters>]\n"
+                   u8"                                  [--duration <seconds>] [--error-budget <relative error>]\n"
+                   u8"                                  [--drift-budget <relative drift>]\n");
+        return false;
+    }
+
+    options.generator_settings.thread_count = options.thread_count;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Harness_Options options;
+    if(!parse_options(argc, argv, options)) {
+        return -1;
+    }
+
+    Console_Output cout;
+    World reference_world;
+    load_scene(reference_world, options);
+    Slice<Point_Mass const> const reference_point_masses = get_point_masses(reference_world);
+    i64 const count = reference_point_masses.size();
+    f64 const initial_energy = compute_total_energy(reference_point_masses, options.thread_count, options.softening, options.softening_length);
+
+    // The exact direct sum with the deterministic pairwise summation is the reference.
+    Array<Vec2> reference_accelerations;
+    reference_accelerations.resize(count);
+    {
+        Physics_Settings settings;
+        settings.thread_count = options.thread_count;
+        settings.deterministic = true;
+        settings.solver = Force_Solver::direct;
+        settings.softening = options.softening;
+        settings.softening_length = options.softening_length;
+        Physics_World* const physics_world = create_physics_world(settings);
+        compute_accelerations(*physics_world, reference_point_masses, Slice<Vec2>{reference_accelerations.begin(), reference_accelerations.end()});
+        destory_physics_world(physics_world);
+    }
+
+    String_View const integrator_name = options.integrator == Integrator::verlet ? String_View{u8"verlet"} : String_View{u8"wisdom_holman"};
+    cout.write(format(u8"# bodies={} threads={} integrator={} duration={}s initial_energy={}\n", count, options.thread_count, integrator_name, options.duration,
+                      initial_energy));
+    cout.write(u8"solver,opening_angle,leaf_size,timestep,rms_force_error,p99_force_error,force_time_ms,run_time_ms,energy_drift\n");
+
+    bool found_within_budget = false;
+    String best_configuration;
+    f64 best_run_time = 0.0;
+    for(Solver_Configuration const& configuration: solver_configurations) {
+        Physics_Settings settings;
+        settings.thread_count = options.thread_count;
+        settings.solver = configuration.solver;
+        settings.integrator = options.integrator;
+        settings.softening = options.softening;
+        settings.softening_length = options.softening_length;
+        if(configuration.solver == Force_Solver::tree) {
+            settings.opening_angle = configuration.opening_angle;
+            settings.leaf_size = configuration.leaf_size;
+        }
+
+        // Force error and the cost of a single force evaluation.
+        Array<Vec2> accelerations;
+        accelerations.resize(count);
+        f64 force_times[timing_repetitions];
+        {
+            Physics_World* const physics_world = create_physics_world(settings);
+            for(f64& force_time: force_times) {
+                f64 const begin = get_time_ms();
+                compute_accelerations(*physics_world, reference_point_masses, Slice<Vec2>{accelerations.begin(), accelerations.end()});
+                force_time = get_time_ms() - begin;
+            }
+            destory_physics_world(physics_world);
+        }
+        std::sort(force_times, force_times + timing_repetitions);
+        f64 const force_time = force_times[timing_repetitions / 2];
+        Force_Error const force_error = compute_force_error(Slice<Vec2 const>{reference_accelerations.begin(), reference_accelerations.end()},
+                                                            Slice<Vec2 const>{accelerations.begin(), accelerations.end()});
+
+        // Energy drift over the simulated duration for every timestep.
+        for(f32 const base_timestep: timesteps) {
+            f32 const timestep = base_timestep * options.timestep_scale;
+            settings.timestep = timestep;
+            World world;
+            load_scene(world, options);
+            Physics_World* const physics_world = create_physics_world(settings);
+            i64 const steps = (i64)std::ceil(options.duration / timestep);
+            f64 const begin = get_time_ms();
+            for(i64 step = 0; step < steps; ++step) {
+                run_physics(*physics_world, world, timestep);
+            }
+            f64 const run_time = get_time_ms() - begin;
+            destory_physics_world(physics_world);
+
+            f64 const energy = compute_total_energy(get_point_masses(world), options.thread_count, options.softening, options.softening_length);
+            f64 const energy_drift = initial_energy != 0.0 ? std::abs((energy - initial_energy) / initial_energy) : 0.0;
+            String_View const solver_name = configuration.solver == Force_Solver::direct ? String_View{u8"direct"} : String_View{u8"tree"};
+            String const row = format(u8"{},{},{},{},{},{},{},{},{}", solver_name, configuration.opening_angle, configuration.leaf_size, timestep, force_error.rms,
+                                      force_error.p99, force_time, run_time, energy_drift);
+            cout.write(row);
+            cout.write(u8"\n");
+
+            bool const within_budget = force_error.p99 <= options.error_budget && energy_drift <= options.drift_budget;
+            if(options.error_budget >= 0.0 && within_budget && (!found_within_budget || run_time < best_run_time)) {
+                found_within_budget = true;
+                best_run_time = run_time;
+                best_configuration = row;
+            }
+        }
+    }
+
+    if(options.error_budget >= 0.0) {
+        if(found_within_budget) {
+            cout.write(format(u8"# fastest within budget: {}\n", best_configuration));
+        } else {
+            cout.write(u8"# no configuration meets the error and drift budgets\n");
+        }
+    }
+
+    return 0;
+}
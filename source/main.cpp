@@ -1,16 +1,30 @@
+#include <allocation_tracking.hpp>
 #include <anton/console.hpp>
 #include <anton/filesystem.hpp>
 #include <anton/format.hpp>
 #include <anton/math/transform.hpp>
 #include <anton/string.hpp>
 #include <build.hpp>
+#include <determinism.hpp>
 #include <entity.hpp>
+#include <file.hpp>
+#include <frame_encoder.hpp>
+#include <generators.hpp>
 #include <input.hpp>
 #include <mesh.hpp>
+#include <offscreen.hpp>
 #include <physics.hpp>
+#include <quadtree.hpp>
 #include <point_mass.hpp>
 #include <rendering.hpp>
+#include <scene.hpp>
 #include <shader.hpp>
+#include <spatial_order.hpp>
+#include <threads.hpp>
+#include <timeline.hpp>
+#include <trace.hpp>
+#include <tracer.hpp>
+#include <trails.hpp>
 #include <transform.hpp>
 #include <world.hpp>
 
@@ -19,17 +33,17 @@
 
 #include <glad/glad.h>
 
-static String read_file(String const& path) {
-    fs::Input_File_Stream stream(path);
-    ANTON_FAIL(stream, "could not open file for reading");
-    stream.seek(Seek_Dir::end, 0);
-    i64 size = stream.tell();
-    stream.seek(Seek_Dir::beg, 0);
-    String result{reserve, size};
-    result.force_size(size);
-    stream.read(result.data(), size);
-    return result;
-}
+#include <chrono>
+#include <thread>
+
+// Longest sleep between two polls of the events. mimas cannot block until an event arrives.
+constexpr f64 idle_poll_interval = 0.01;
+// A press and release closer than this in pixels is a click rather than a drag.
+constexpr i32 click_tolerance = 4;
+// Distance from the cursor in pixels within which a click picks a body.
+constexpr f32 pick_radius = 8.0f;
+// Radius of the selection around the cursor of a right click in pixels.
+constexpr f32 selection_radius = 32.0f;
 
 static anton::Array<math::Vec3> generate_circle(math::Vec3 const& origin, math::Vec3 const& normal, f32 const radius, i32 const vert_count) {
     f32 const angle = math::two_pi / static_cast<f32>(vert_count);
@@ -68,6 +82,10 @@ struct Application_Context {
     f32 object_scale = 1.0f;
     bool single_step = true;
     bool debug_printing = false;
+    // Substep of the displayed state.
+    i64 step = 0;
+    // Substep requested from the timeline while scrubbing.
+    i64 scrub_step = 0;
 
     Vec2 camera_position;
     Vec2 camera_position_prev;
@@ -75,10 +93,28 @@ struct Application_Context {
     bool lmb_up_down_transitioned = false;
     i32 cursor_pos_x = 0;
     i32 cursor_pos_y = 0;
+    // The displayed frame is out of date.
+    bool redraw = true;
+
+    // Latest position of the cursor in the window.
+    i32 mouse_x = 0;
+    i32 mouse_y = 0;
+    bool rmb_down = false;
+    i32 rmb_press_x = 0;
+    i32 rmb_press_y = 0;
+    // Clicks and drags of the mouse, handled by the main loop which has access to the bodies.
+    enum struct Query { none, pick, radius, rectangle };
+    Query query = Query::none;
+    // Window coordinates of the query. The rectangle spans from the first to the second corner.
+    i32 query_x0 = 0;
+    i32 query_y0 = 0;
+    i32 query_x1 = 0;
+    i32 query_y1 = 0;
 };
 
 static void scroll_callback(Mimas_Window* window, f32 dx, f32 dy, void* user_data) {
     Application_Context& ctx = *(Application_Context*)user_data;
+    ctx.redraw = true;
     if(dy < 0) {
         ctx.zoom *= 2.0f;
     } else if(dy > 0) {
@@ -109,6 +145,32 @@ static void mouse_button_callback(Mimas_Window* window, Mimas_Key button, Mimas_
     if(!ctx.lmb_down && ctx.lmb_up_down_transitioned) {
         ctx.camera_position_prev = ctx.camera_position;
     }
+
+    if(button == MIMAS_MOUSE_LEFT_BUTTON && !ctx.lmb_down && ctx.lmb_up_down_transitioned) {
+        // Released without moving the camera.
+        if(math::abs(ctx.mouse_x - ctx.cursor_pos_x) <= click_tolerance && math::abs(ctx.mouse_y - ctx.cursor_pos_y) <= click_tolerance) {
+            ctx.query = Application_Context::Query::pick;
+            ctx.query_x0 = ctx.mouse_x;
+            ctx.query_y0 = ctx.mouse_y;
+        }
+    }
+
+    if(button == MIMAS_MOUSE_RIGHT_BUTTON) {
+        bool const pressed = action == MIMAS_MOUSE_BUTTON_PRESS;
+        if(pressed && !ctx.rmb_down) {
+            ctx.rmb_press_x = ctx.mouse_x;
+            ctx.rmb_press_y = ctx.mouse_y;
+        } else if(!pressed && ctx.rmb_down) {
+            // A click selects the bodies around the cursor, a drag the bodies inside of the rectangle.
+            bool const click = math::abs(ctx.mouse_x - ctx.rmb_press_x) <= click_tolerance && math::abs(ctx.mouse_y - ctx.rmb_press_y) <= click_tolerance;
+            ctx.query = click ? Application_Context::Query::radius : Application_Context::Query::rectangle;
+            ctx.query_x0 = ctx.rmb_press_x;
+            ctx.query_y0 = ctx.rmb_press_y;
+            ctx.query_x1 = ctx.mouse_x;
+            ctx.query_y1 = ctx.mouse_y;
+        }
+        ctx.rmb_down = pressed;
+    }
 }
 
 static Vec2 get_window_content_size(Mimas_Window* window) {
@@ -117,8 +179,16 @@ static Vec2 get_window_content_size(Mimas_Window* window) {
     return Vec2(x, y);
 }
 
+// Position in the world under the window coordinates (x, y).
+static Vec2 window_to_world(Application_Context const& ctx, Vec2 const window_size, i32 const x, i32 const y) {
+    f32 const scale = 2.0f * ctx.zoom / window_size.y;
+    return ctx.camera_position + Vec2{(f32)x - 0.5f * window_size.x, (f32)y - 0.5f * window_size.y} * scale;
+}
+
 static void cursor_pos_callback(Mimas_Window* window, mimas_i32 x, mimas_i32 y, void* user_data) {
     Application_Context& ctx = *(Application_Context*)user_data;
+    ctx.mouse_x = x;
+    ctx.mouse_y = y;
     if(ctx.lmb_down) {
         Vec2 const position_delta(x - ctx.cursor_pos_x, y - ctx.cursor_pos_y);
         Vec2 const vp_size = get_window_content_size(window);
@@ -128,79 +198,236 @@ static void cursor_pos_callback(Mimas_Window* window, mimas_i32 x, mimas_i32 y,
         scale *= 2.0f / vp_size.y;
         scale *= ctx.zoom;
         ctx.camera_position = scale * position_delta + ctx.camera_position_prev;
+        ctx.redraw = true;
     }
 }
 
 static void key_callback(Mimas_Window* window, Mimas_Key key, Mimas_Key_Action action, void* user_data) {
+    Application_Context& ctx = *(Application_Context*)user_data;
+    // Keys toggle the rendering and the simulation state.
+    ctx.redraw = true;
     add_key_event(key, action);
 }
 
-static void load_sim_data_from_file(World& world, String const& path) {
-    String contents = read_file(path);
-
-    auto parse_csv_file = [](String const& contents) -> Array<Point_Mass> {
-        auto find_line_end = [](auto begin, auto end) {
-            for(; begin != end && *begin != '\n'; ++begin) {}
-            return begin;
-        };
-
-        auto read_float = [](auto& begin, auto end) {
-            i64 pos = find_substring(String_View{begin, end}, ",");
-            auto first = begin;
-            // Skip spaces
-            while(*first == ' ') {
-                ++first;
-            }
+struct Command_Line_Options {
+    Physics_Settings physics_settings;
+    bool check_determinism = false;
+    Array<String> scene_paths;
+    // Generate the scene instead of loading sim.txt.
+    bool generate = false;
+    Generator_Settings generator_settings;
+    Timeline_Settings timeline_settings;
+    // Number of massless tracers to generate around the bodies.
+    i64 tracer_count = 0;
+    // Maximum number of rendered frames per second. 0 does not limit the frame rate.
+    f32 fps_cap = 0.0f;
+    // Number of substeps between the sorting of the bodies along reorder_curve. 0 disables the sorting.
+    i64 reorder_interval = 0;
+    Space_Filling_Curve reorder_curve = Space_Filling_Curve::hilbert;
+    // Render frame_count frames offscreen into record_directory instead of running interactively.
+    String record_directory;
+    Frame_Format record_format = Frame_Format::png;
+    i64 frame_count = 600;
+    // Simulated time between two recorded frames in seconds.
+    f32 frame_time = 1.0f / 60.0f;
+    i32 record_width = 1280;
+    i32 record_height = 720;
+    // Print the allocations of every frame that allocates.
+    bool allocation_report = false;
+    // Fail the run if any frame from this one on allocates. -1 disables the check.
+    i64 steady_state_frame = -1;
+};
 
-            auto last = begin;
-            if(pos != npos) {
-                last += pos;
+// parse_command_line
+// Supported options:
+// --threads <count>          number of threads used by the physics (defaults to all hardware threads).
+// --deterministic            make the physics results independent of the thread count.
+// --solver <direct|tree>     force solver (defaults to direct).
+// --opening-angle <angle>    opening angle of the tree solver (defaults to 0.5).
+// --auto-tune                periodically pick the fastest solver and thread count within the error budget.
+// --tune-interval <steps>    number of substeps between the tunings (defaults to 4096).
+// --error-budget <error>     largest 99th percentile of the relative force error of a tuned solver (defaults to 0.001).
+// --integrator <verlet|wisdom_holman>
+//                            integrator (defaults to verlet).
+// --timestep <seconds>       fixed timestep of the physics (defaults to 1/240).
+// --softening <plummer|spline>
+//                            softening kernel of the forces (defaults to spline).
+// --softening-length <m>     softening length, the support radius of the spline kernel (defaults to 1).
+// --processes <count>        number of worker processes of the domain decomposition (defaults to 1). Linux only.
+// --check-determinism [file...]
+//                            step the given scenes and generated scenes with different thread counts,
+//                            compare the results and exit.
+// --generate <generator>     generate the scene instead of loading sim.txt. See Generator_Kind.
+// --count <count>            number of bodies to generate (defaults to 1000).
+// --tracers <count>          number of massless tracers to generate around the bodies (defaults to 0).
+// --seed <seed>              seed of the generator (defaults to 0).
+// --fps-cap <fps>            maximum number of rendered frames per second (defaults to 0, unlimited).
+// --reorder-interval <steps> sort the storage of the bodies along a space-filling curve every steps substeps
+//                            (defaults to 0, never).
+// --reorder-curve <morton|hilbert>
+//                            curve of the sorting (defaults to hilbert).
+// --timeline-budget <MB>     memory budget of the timeline keyframes in megabytes (defaults to 256).
+// --record <directory>       render the frames offscreen and write them to directory instead of opening the window.
+// --record-format <png|raw>  format of the recorded frames (defaults to png).
+// --record-size <width> <height>
+//                            size of the recorded frames (defaults to 1280 720).
+// --frames <count>           number of frames to record (defaults to 600).
+// --frame-time <seconds>     simulated time between the recorded frames (defaults to 1/60).
+// --allocation-report        print the heap allocations of every frame that allocates. Requires allocation tracking.
+// --fail-on-allocation <frame>
+//                            exit with an error if any frame starting from frame allocates. Requires allocation tracking.
+//
+static bool parse_command_line(i32 const argc, char** const argv, Command_Line_Options& options) {
+    Console_Output cout;
+    options.physics_settings.thread_count = get_hardware_thread_count();
+    for(i32 i = 1; i < argc; ++i) {
+        String_View const argument{argv[i]};
+        if(argument == u8"--threads" && i + 1 < argc) {
+            i += 1;
+            options.physics_settings.thread_count = math::max((i32)str_to_i64(argv[i]), 1);
+        } else if(argument == u8"--deterministic") {
+            options.physics_settings.deterministic = true;
+        } else if(argument == u8"--solver" && i + 1 < argc) {
+            i += 1;
+            String_View const solver{argv[i]};
+            if(solver == u8"direct") {
+                options.physics_settings.solver = Force_Solver::direct;
+            } else if(solver == u8"tree") {
+                options.physics_settings.solver = Force_Solver::tree;
             } else {
-                last = end;
+                cout.write(format(u8"unknown solver {}\n", solver));
+                return false;
             }
-
-            begin = last;
-            if(begin != end) {
-                ++begin;
+        } else if(argument == u8"--integrator" && i + 1 < argc) {
+            i += 1;
+            if(!parse_integrator(argv[i], options.physics_settings.integrator)) {
+                cout.write(format(u8"unknown integrator {}\n", argv[i]));
+                return false;
             }
-
-            return str_to_f32(String{first, last});
-        };
-
-        Array<Point_Mass> point_masses;
-        auto begin = contents.bytes_begin();
-        auto end = contents.bytes_end();
-        while(begin != end) {
-            auto line_end = find_line_end(begin, end);
-            f32 const pos_x = read_float(begin, line_end);
-            f32 const pos_y = read_float(begin, line_end);
-            f32 const vel_x = read_float(begin, line_end);
-            f32 const vel_y = read_float(begin, line_end);
-            f32 const mass = read_float(begin, line_end);
-            point_masses.emplace_back(Point_Mass{Vec2{pos_x, pos_y}, Vec2{vel_x, vel_y}, mass});
-
-            begin = line_end;
-            // begin points either to '\n' or end.
-            // move to the next line if not equal to end
-            if(begin != end) {
-                ++begin;
+        } else if(argument == u8"--opening-angle" && i + 1 < argc) {
+            i += 1;
+            options.physics_settings.opening_angle = str_to_f32(argv[i]);
+        } else if(argument == u8"--auto-tune") {
+            options.physics_settings.auto_tune = true;
+        } else if(argument == u8"--tune-interval" && i + 1 < argc) {
+            i += 1;
+            options.physics_settings.tune_interval = math::max(str_to_i64(argv[i]), (i64)1);
+        } else if(argument == u8"--error-budget" && i + 1 < argc) {
+            i += 1;
+            options.physics_settings.error_budget = str_to_f32(argv[i]);
+        } else if(argument == u8"--timestep" && i + 1 < argc) {
+            i += 1;
+            options.physics_settings.timestep = str_to_f32(argv[i]);
+            if(!(options.physics_settings.timestep > 0.0f)) {
+                cout.write(format(u8"timestep must be greater than 0, got {}\n", argv[i]));
+                return false;
+            }
+        } else if(argument == u8"--softening" && i + 1 < argc) {
+            i += 1;
+            if(!parse_softening(argv[i], options.physics_settings.softening)) {
+                cout.write(format(u8"unknown softening {}\n", argv[i]));
+                return false;
+            }
+        } else if(argument == u8"--softening-length" && i + 1 < argc) {
+            i += 1;
+            options.physics_settings.softening_length = math::max(str_to_f32(argv[i]), 1e-3f);
+        } else if(argument == u8"--processes" && i + 1 < argc) {
+            i += 1;
+            options.physics_settings.process_count = math::max((i32)str_to_i64(argv[i]), 1);
+        } else if(argument == u8"--check-determinism") {
+            options.check_determinism = true;
+            for(; i + 1 < argc && argv[i + 1][0] != '-'; ++i) {
+                options.scene_paths.emplace_back(argv[i + 1]);
+            }
+        } else if(argument == u8"--generate" && i + 1 < argc) {
+            i += 1;
+            options.generate = true;
+            if(!parse_generator_kind(argv[i], options.generator_settings.kind)) {
+                cout.write(format(u8"unknown generator {}\n", argv[i]));
+                return false;
             }
+        } else if(argument == u8"--count" && i + 1 < argc) {
+            i += 1;
+            options.generator_settings.count = math::max(str_to_i64(argv[i]), (i64)0);
+        } else if(argument == u8"--tracers" && i + 1 < argc) {
+            i += 1;
+            options.tracer_count = math::max(str_to_i64(argv[i]), (i64)0);
+        } else if(argument == u8"--fps-cap" && i + 1 < argc) {
+            i += 1;
+            options.fps_cap = math::max(str_to_f32(argv[i]), 0.0f);
+        } else if(argument == u8"--reorder-interval" && i + 1 < argc) {
+            i += 1;
+            options.reorder_interval = math::max(str_to_i64(argv[i]), (i64)0);
+        } else if(argument == u8"--reorder-curve" && i + 1 < argc) {
+            i += 1;
+            if(!parse_space_filling_curve(argv[i], options.reorder_curve)) {
+                cout.write(format(u8"unknown curve {}\n", argv[i]));
+                return false;
+            }
+        } else if(argument == u8"--seed" && i + 1 < argc) {
+            i += 1;
+            options.generator_settings.seed = (u64)str_to_i64(argv[i]);
+        } else if(argument == u8"--timeline-budget" && i + 1 < argc) {
+            i += 1;
+            options.timeline_settings.keyframe_budget = math::max(str_to_i64(argv[i]), (i64)1) * 1024 * 1024;
+        } else if(argument == u8"--record" && i + 1 < argc) {
+            i += 1;
+            options.record_directory = String{argv[i]};
+        } else if(argument == u8"--record-format" && i + 1 < argc) {
+            i += 1;
+            if(!parse_frame_format(argv[i], options.record_format)) {
+                cout.write(format(u8"unknown frame format {}\n", argv[i]));
+                return false;
+            }
+        } else if(argument == u8"--record-size" && i + 2 < argc) {
+            options.record_width = math::max((i32)str_to_i64(argv[i + 1]), 1);
+            options.record_height = math::max((i32)str_to_i64(argv[i + 2]), 1);
+            i += 2;
+        } else if(argument == u8"--frames" && i + 1 < argc) {
+            i += 1;
+            options.frame_count = math::max(str_to_i64(argv[i]), (i64)0);
+        } else if(argument == u8"--frame-time" && i + 1 < argc) {
+            i += 1;
+            options.frame_time = str_to_f32(argv[i]);
+            if(!(options.frame_time > 0.0f)) {
+                cout.write(format(u8"frame time must be greater than 0, got {}\n", argv[i]));
+                return false;
+            }
+        } else if(argument == u8"--allocation-report") {
+            options.allocation_report = true;
+        } else if(argument == u8"--fail-on-allocation" && i + 1 < argc) {
+            i += 1;
+            options.steady_state_frame = math::max(str_to_i64(argv[i]), (i64)0);
+        } else {
+            cout.write(format(u8"unknown or incomplete option {}\n", argument));
+            return false;
         }
+    }
 
-        return point_masses;
-    };
-
-    for(Point_Mass const& point_mass: parse_csv_file(contents)) {
-        Entity e = world.create();
-        world.add_component(e, point_mass);
-        world.add_component(e, Transform{});
+    if((options.allocation_report || options.steady_state_frame >= 0) && !is_allocation_tracking_available()) {
+        cout.write(u8"allocation tracking is not available, configure with -DGRAVITY_SIMULATION_ALLOCATION_TRACKING=ON on a glibc system\n");
+        return false;
     }
+    return true;
 }
 
 int main(int argc, char** argv) {
     String const executable_path{fs::normalize_path(argv[0])};
     String const executable_directory{fs::get_directory_name(executable_path)};
 
+    Command_Line_Options options;
+    if(!parse_command_line(argc, argv, options)) {
+        return -1;
+    }
+
+    options.generator_settings.thread_count = options.physics_settings.thread_count;
+    // Cache a state per frame at 60 fps.
+    options.timeline_settings.cache_stride = math::max((i64)(1.0f / (60.0f * options.physics_settings.timestep) + 0.5f), (i64)1);
+    if(options.check_determinism) {
+        bool const deterministic = check_determinism(Slice<String const>{options.scene_paths.begin(), options.scene_paths.end()});
+        return deterministic ? 0 : 1;
+    }
+
     Application_Context application_context;
 
     Mimas_Init_Options init_options;
@@ -255,6 +482,16 @@ int main(int argc, char** argv) {
         isolines_shader = create_shader("isolines", handle_vertex, handle_fragment);
     }
 
+    Handle<Shader> point_shader;
+    {
+        String source_vertex = read_file(executable_directory + "/points.vert");
+        Handle<Shader_Stage> handle_vertex = compile_shader_source("points_vertex", Shader_Stage_Type::vertex, source_vertex);
+        String source_fragment = read_file(executable_directory + "/points.frag");
+        Handle<Shader_Stage> handle_fragment = compile_shader_source("points_fragment", Shader_Stage_Type::fragment, source_fragment);
+        point_shader = create_shader("points", handle_vertex, handle_fragment);
+    }
+    set_point_shader(point_shader);
+
     Handle<Mesh> circle_mesh;
     {
         Array<Vec3> circle = generate_filled_circle(128);
@@ -265,6 +502,16 @@ int main(int argc, char** argv) {
         circle_mesh = add_mesh(ANTON_MOV(mesh));
     }
 
+    Handle<Mesh> low_detail_circle_mesh;
+    {
+        Array<Vec3> circle = generate_filled_circle(16);
+        Mesh mesh;
+        for(Vec3 v: circle) {
+            mesh.vertices.emplace_back(Vertex{v, Vec4{0.698f, 0.29f, 1.0f, 1.0f}});
+        }
+        low_detail_circle_mesh = add_mesh(ANTON_MOV(mesh));
+    }
+
     Handle<Mesh> square_mesh;
     {
         Mesh mesh;
@@ -286,26 +533,298 @@ int main(int argc, char** argv) {
     world.register_type<Mesh_Renderer>();
     world.register_type<Transform>();
     world.register_type<Isolines>();
+    world.register_type<Tracer_Cloud>();
+    world.register_type<Orbit_Trails>();
 
     Entity const isolines_entity = world.create();
     world.add_component(isolines_entity, Isolines{square_mesh, isolines_shader});
     Isolines& isolines = world.get_component<Isolines>(isolines_entity);
     isolines.enabled = true;
     isolines.mode = Isolines::Render_Mode::contour_inverted;
+    isolines.softening = options.physics_settings.softening;
+    isolines.softening_length = options.physics_settings.softening_length;
 
-    load_sim_data_from_file(world, executable_directory + "/sim.txt");
+    Entity const trails_entity = world.create();
+    world.add_component(trails_entity, Orbit_Trails{});
+    Orbit_Trails& trails = world.get_component<Orbit_Trails>(trails_entity);
+
+    if(options.generate) {
+        generate_scene(world, options.generator_settings);
+    } else {
+        load_scene_from_file(world, executable_directory + "/sim.txt");
+    }
     for(Entity const e: world.entities<Point_Mass>()) {
-        world.add_component(e, Mesh_Renderer{circle_mesh, mesh_shader});
+        world.add_component(e, Mesh_Renderer{circle_mesh, mesh_shader, low_detail_circle_mesh});
     }
 
-    Physics_World* physics_world = create_physics_world();
+    if(options.tracer_count > 0) {
+        generate_tracers(world, options.tracer_count, options.generator_settings.seed, options.physics_settings.thread_count);
+    }
 
-    mimas_show_window(window);
+    Physics_World* physics_world = create_physics_world(options.physics_settings);
+    Timeline* timeline = nullptr;
+    {
+        Slice<Point_Mass> const point_masses = world.components<Point_Mass>();
+        timeline = create_timeline(options.physics_settings, options.timeline_settings, Slice<Point_Mass const>{point_masses.begin(), point_masses.end()});
+    }
+
+    bool const recording = options.record_directory.size_bytes() > 0;
+    if(!recording) {
+        mimas_show_window(window);
+    }
+
+    String const trace_path = executable_directory + "/trace.json";
 
     Console_Output cout;
+
+    // Incremented whenever the displayed state of the bodies changes.
+    i64 state_version = 0;
+    i64 steps_since_reorder = 0;
+    Array<i64> reorder_order;
+    i64 reported_tuning = 0;
+    auto advance_simulation = [&](f32 const delta_time) {
+        // The live simulation continues from the displayed state.
+        cancel_timeline_seek(*timeline);
+        i64 substeps = 0;
+        {
+            ALLOCATION_SCOPE(Allocation_Tag::physics);
+            substeps = run_physics(*physics_world, world, delta_time);
+        }
+        if(Physics_Tuning const tuning = get_physics_tuning(*physics_world); tuning.generation != reported_tuning) {
+            reported_tuning = tuning.generation;
+            // The tuning precedes the substeps of run_physics.
+            {
+                ALLOCATION_SCOPE(Allocation_Tag::timeline);
+                record_timeline_settings(*timeline, get_physics_settings(*physics_world), application_context.step);
+            }
+            if(tuning.solver == Force_Solver::tree) {
+                cout.write(format(u8"tuned: tree with opening angle {} on {} threads, {} ms per evaluation, p99 error {}\n", tuning.opening_angle,
+                                  tuning.thread_count, tuning.evaluation_time, tuning.error));
+            } else {
+                cout.write(format(u8"tuned: direct on {} threads, {} ms per evaluation\n", tuning.thread_count, tuning.evaluation_time));
+            }
+        }
+        application_context.step += substeps;
+        application_context.scrub_step = application_context.step;
+        steps_since_reorder += substeps;
+        if(options.reorder_interval > 0 && steps_since_reorder >= options.reorder_interval) {
+            // Bodies close in space become close in memory, which keeps the tree traversal in cache.
+            ALLOCATION_SCOPE(Allocation_Tag::physics);
+            steps_since_reorder = 0;
+            reorder_bodies(world, options.reorder_curve, options.physics_settings.thread_count, reorder_order);
+            permute_orbit_trails(trails, reorder_order);
+            permute_timeline(*timeline, reorder_order);
+        }
+        Slice<Point_Mass> const point_masses = world.components<Point_Mass>();
+        {
+            ALLOCATION_SCOPE(Allocation_Tag::timeline);
+            record_timeline_step(*timeline, Slice<Point_Mass const>{point_masses.begin(), point_masses.end()}, application_context.step);
+        }
+        if(substeps > 0) {
+            ALLOCATION_SCOPE(Allocation_Tag::trails);
+            update_orbit_trails(trails, Slice<Point_Mass const>{point_masses.begin(), point_masses.end()});
+            application_context.redraw = true;
+            state_version += 1;
+        }
+        if(application_context.debug_printing) {
+            ALLOCATION_SCOPE(Allocation_Tag::debug_output);
+            for(Entity const entity: world.entities<Point_Mass>()) {
+                Point_Mass const& point_mass = world.get_component<Point_Mass>(entity);
+                cout.write(format(u8"{}: ({}, {}); ({}, {}); {}\n", entity.id, point_mass.position.x, point_mass.position.y, point_mass.velocity.x,
+                                  point_mass.velocity.y, point_mass.mass));
+            }
+        }
+    };
+
+    // Answers the picking and selection queries. The index is only rebuilt when a query
+    // arrives after the state has changed, hence moving the mouse costs nothing.
+    Quadtree spatial_index;
+    i64 spatial_index_version = -1;
+    Array<i64> query_result;
+    // Bodies of the latest region selection.
+    Array<Entity> selection;
+    auto run_query = [&]() {
+        TRACE_ZONE("spatial_query");
+        ALLOCATION_SCOPE(Allocation_Tag::query);
+        Slice<Point_Mass> const point_masses = world.components<Point_Mass>();
+        Slice<Point_Mass const> const sources{point_masses.begin(), point_masses.end()};
+        if(spatial_index_version != state_version) {
+            build_quadtree(spatial_index, sources, 16);
+            spatial_index_version = state_version;
+        }
+
+        Vec2 const window_size = get_window_content_size(window);
+        f32 const pixel_size = 2.0f * application_context.zoom / window_size.y;
+        Vec2 const position0 = window_to_world(application_context, window_size, application_context.query_x0, application_context.query_y0);
+        Slice<Entity> const entities = world.entities<Point_Mass>();
+        query_result.clear();
+        switch(application_context.query) {
+            case Application_Context::Query::pick: {
+                i64 const index = find_nearest_in_quadtree(spatial_index, sources, position0, pick_radius * pixel_size);
+                if(index == -1) {
+                    cout.write(u8"no body under the cursor\n");
+                } else {
+                    Point_Mass const& body = point_masses[index];
+                    cout.write(format(u8"body {}: position ({}, {}), velocity ({}, {}), mass {}\n", entities[index].id, body.position.x, body.position.y,
+                                      body.velocity.x, body.velocity.y, body.mass));
+                }
+                return;
+            }
+
+            case Application_Context::Query::radius: {
+                query_quadtree_radius(spatial_index, sources, position0, selection_radius * pixel_size, query_result);
+            } break;
+
+            case Application_Context::Query::rectangle: {
+                Vec2 const position1 = window_to_world(application_context, window_size, application_context.query_x1, application_context.query_y1);
+                Vec2 const min{math::min(position0.x, position1.x), math::min(position0.y, position1.y)};
+                Vec2 const max{math::max(position0.x, position1.x), math::max(position0.y, position1.y)};
+                query_quadtree_rectangle(spatial_index, sources, min, max, query_result);
+            } break;
+
+            case Application_Context::Query::none:
+                return;
+        }
+
+        selection.clear();
+        f64 mass = 0.0;
+        f64 weighted_x = 0.0;
+        f64 weighted_y = 0.0;
+        f64 momentum_x = 0.0;
+        f64 momentum_y = 0.0;
+        for(i64 const index: query_result) {
+            Point_Mass const& body = point_masses[index];
+            selection.emplace_back(entities[index]);
+            mass += body.mass;
+            weighted_x += (f64)body.position.x * body.mass;
+            weighted_y += (f64)body.position.y * body.mass;
+            momentum_x += (f64)body.velocity.x * body.mass;
+            momentum_y += (f64)body.velocity.y * body.mass;
+        }
+
+        if(mass > 0.0) {
+            cout.write(format(u8"selected {} bodies: mass {}, center of mass ({}, {}), velocity of the center of mass ({}, {})\n", selection.size(), mass,
+                              weighted_x / mass, weighted_y / mass, momentum_x / mass, momentum_y / mass));
+        } else {
+            cout.write(format(u8"selected {} bodies\n", selection.size()));
+        }
+    };
+
+    // Draws the world as seen by the camera into the bound framebuffer.
+    auto render_frame = [&](i32 const width, i32 const height) {
+        ALLOCATION_SCOPE(Allocation_Tag::rendering);
+        {
+            TRACE_ZONE("sync_transforms");
+            for(Entity const entity: world.entities<Point_Mass>()) {
+                Point_Mass& point_mass = world.get_component<Point_Mass>(entity);
+                Transform& transform = world.get_component<Transform>(entity);
+                transform.postion = Vec3{point_mass.position, 0.0f};
+                f32 const scale_factor = application_context.object_scale * log2(point_mass.mass);
+                transform.scale = Vec3{scale_factor};
+            }
+        }
+
+        f32 const aspect_ratio = (f32)width / (f32)height;
+        f32 const zoom = application_context.zoom;
+
+        Mat4 const view = lookat_rh(Vec3{application_context.camera_position, 5.0f}, Vec3{application_context.camera_position, -1.0f}, Vec3{0.0f, 1.0f, 0.0f});
+        Mat4 const proj = orthographic_rh(-aspect_ratio * zoom, aspect_ratio * zoom, -zoom, zoom, 0.0f, 10.0f);
+
+        glViewport(0, 0, width, height);
+        render(world, view, proj, Vec2{(f32)width, (f32)height});
+    };
+
+    // The allocations of the frames. Reporting happens between the frames, so that the
+    // allocations of the report itself are not attributed to any frame.
+    Allocation_Snapshot frame_allocations_begin = take_allocation_snapshot();
+    Allocation_Snapshot steady_state_allocations;
+    i64 allocating_steady_state_frames = 0;
+    i64 frame_index = 0;
+    auto account_frame_allocations = [&]() {
+        Allocation_Snapshot frame_allocations = get_allocations_between(frame_allocations_begin, take_allocation_snapshot());
+        // The encoder threads work through the queued frames on their own schedule.
+        frame_allocations.tags[(i32)Allocation_Tag::encoder] = {};
+        Allocation_Counts const total = get_allocation_total(frame_allocations);
+        TRACE_COUNTER("frame_allocations", total.count);
+        TRACE_COUNTER("frame_allocated_bytes", total.bytes);
+        if(total.count > 0) {
+            ALLOCATION_SCOPE(Allocation_Tag::debug_output);
+            if(options.allocation_report) {
+                String summary = format(u8"frame {}: {} allocations, {} bytes", frame_index, total.count, total.bytes);
+                for(i32 tag = 0; tag < allocation_tag_count; ++tag) {
+                    Allocation_Counts const& counts = frame_allocations.tags[tag];
+                    if(counts.count > 0) {
+                        summary += format(u8"; {} {} allocations, {} bytes", get_allocation_tag_name((Allocation_Tag)tag), counts.count, counts.bytes);
+                    }
+                }
+                summary += u8"\n";
+                cout.write(summary);
+            }
+
+            if(options.steady_state_frame >= 0 && frame_index >= options.steady_state_frame) {
+                allocating_steady_state_frames += 1;
+                for(i32 tag = 0; tag < allocation_tag_count; ++tag) {
+                    steady_state_allocations.tags[tag].count += frame_allocations.tags[tag].count;
+                    steady_state_allocations.tags[tag].bytes += frame_allocations.tags[tag].bytes;
+                }
+            }
+        }
+        frame_index += 1;
+        frame_allocations_begin = take_allocation_snapshot();
+    };
+
+    if(recording) {
+        // Rendering of a frame, the readback of the preceding frames through the ring of pixel
+        // pack buffers and the encoding of the frames before them on the encoder threads overlap.
+        constexpr i32 readback_ring_size = 3;
+        i32 const width = options.record_width;
+        i32 const height = options.record_height;
+        i32 const encoder_thread_count = math::max(get_hardware_thread_count() / 2, 1);
+        Offscreen_Target* const target = create_offscreen_target(width, height, readback_ring_size);
+        Frame_Encoder* const encoder = create_frame_encoder(options.record_directory, options.record_format, encoder_thread_count, 2 * encoder_thread_count);
+        i64 written_frames = 0;
+        auto retrieve_frame = [&]() {
+            Array<u8> pixels = acquire_frame_buffer(*encoder, width, height);
+            i64 frame_index = 0;
+            // Waits for the copy, hence fails only when no readback is queued.
+            bool const retrieved = end_readback(*target, true, frame_index, pixels.data());
+            ANTON_FAIL(retrieved, "no readback to retrieve");
+            submit_frame(*encoder, frame_index, width, height, ANTON_MOV(pixels));
+            written_frames += 1;
+        };
+
+        for(i64 frame = 0; frame < options.frame_count; ++frame) {
+            TRACE_ZONE("record_frame");
+            bind_offscreen_target(*target);
+            render_frame(width, height);
+            if(is_readback_ring_full(*target)) {
+                retrieve_frame();
+            }
+            begin_readback(*target, frame);
+            // The simulation time of a frame is fixed regardless of the wall time.
+            advance_simulation(options.frame_time);
+            account_frame_allocations();
+        }
+
+        while(!is_readback_ring_empty(*target)) {
+            retrieve_frame();
+        }
+
+        destroy_offscreen_target(target);
+        if(destroy_frame_encoder(encoder)) {
+            cout.write(format(u8"{} frames written to {}\n", written_frames, options.record_directory));
+        } else {
+            cout.write(format(u8"failed to write frames to {}\n", options.record_directory));
+        }
+    }
+
     f32 delta_time = 1.0f / 60.0f;
     f32 time = mimas_get_time();
-    while(true) {
+    i32 rendered_width = 0;
+    i32 rendered_height = 0;
+    f64 last_render_time = 0.0;
+    while(!recording) {
+        TRACE_ZONE("frame");
         {
             f32 const new_time = mimas_get_time();
             delta_time = new_time - time;
@@ -321,6 +840,11 @@ int main(int argc, char** argv) {
             break;
         }
 
+        if(application_context.query != Application_Context::Query::none) {
+            run_query();
+            application_context.query = Application_Context::Query::none;
+        }
+
         if(Key_State const key = get_key_state(MIMAS_KEY_Q); key_released(key)) {
             if(application_context.simulation_speed >= 0.001f) {
                 application_context.simulation_speed *= 0.5f;
@@ -353,6 +877,19 @@ int main(int argc, char** argv) {
             application_context.debug_printing = !application_context.debug_printing;
         }
 
+        if(Key_State const key = get_key_state(MIMAS_KEY_P); key_released(key)) {
+            // Start recording or stop and dump the recorded trace.
+            bool const enabled = !is_tracing_enabled();
+            set_tracing_enabled(enabled);
+            if(!enabled) {
+                if(export_trace(trace_path)) {
+                    cout.write(format(u8"trace written to {}\n", trace_path));
+                } else {
+                    cout.write(format(u8"failed to write the trace to {}\n", trace_path));
+                }
+            }
+        }
+
         if(Key_State const key = get_key_state(MIMAS_KEY_T); key_released(key)) {
             isolines.enabled = !isolines.enabled;
         }
@@ -373,52 +910,114 @@ int main(int argc, char** argv) {
             isolines.mode = Isolines::Render_Mode::smooth;
         }
 
+        if(Key_State const key = get_key_state(MIMAS_KEY_O); key_released(key)) {
+            trails.enabled = !trails.enabled;
+        }
+
+        // Scrub the timeline while the arrows are held. Scrubbing pauses the simulation.
+        bool const scrub_backward = get_key_state(MIMAS_KEY_LEFT).down;
+        bool const scrub_forward = get_key_state(MIMAS_KEY_RIGHT).down;
+        if(scrub_backward != scrub_forward) {
+            application_context.single_step = true;
+            i64 const cache_stride = options.timeline_settings.cache_stride;
+            i64 const stride = cache_stride * math::max((i64)application_context.simulation_speed, (i64)1);
+            i64 const target = (application_context.scrub_step + (scrub_backward ? -stride : stride)) / cache_stride * cache_stride;
+            i64 const clamped_target = math::clamp(target, (i64)0, get_timeline_end(*timeline));
+            if(clamped_target != application_context.scrub_step) {
+                application_context.scrub_step = clamped_target;
+                seek_timeline(*timeline, clamped_target);
+            }
+        }
+
+        bool polled = false;
+        i64 step = 0;
+        {
+            ALLOCATION_SCOPE(Allocation_Tag::timeline);
+            polled = poll_timeline(*timeline, world.components<Point_Mass>(), step);
+        }
+        if(polled) {
+            application_context.step = step;
+            // The trails would connect the old and the new state.
+            clear_orbit_trails(trails);
+            application_context.redraw = true;
+            state_version += 1;
+        }
+
         if(application_context.single_step) {
             if(Key_State const key = get_key_state(MIMAS_KEY_S); key_released(key)) {
-                run_physics(*physics_world, world, application_context.simulation_speed / 60.0f);
-                if(application_context.debug_printing) {
-                    for(Entity const entity: world.entities<Point_Mass>()) {
-                        Point_Mass const& point_mass = world.get_component<Point_Mass>(entity);
-                        cout.write(format(u8"{}: ({}, {}); ({}, {}); {}\n", entity.id, point_mass.position.x, point_mass.position.y, point_mass.velocity.x,
-                                          point_mass.velocity.y, point_mass.mass));
-                    }
-                }
+                advance_simulation(application_context.simulation_speed / 60.0f);
             }
         } else {
-            run_physics(*physics_world, world, application_context.simulation_speed * delta_time);
-            if(application_context.debug_printing) {
-                for(Entity const entity: world.entities<Point_Mass>()) {
-                    Point_Mass const& point_mass = world.get_component<Point_Mass>(entity);
-                    cout.write(format(u8"{}: ({}, {}); ({}, {}); {}\n", entity.id, point_mass.position.x, point_mass.position.y, point_mass.velocity.x,
-                                      point_mass.velocity.y, point_mass.mass));
-                }
+            advance_simulation(application_context.simulation_speed * delta_time);
+        }
+
+        // Only render when the camera, the state or the size of the window changed.
+        i32 x, y;
+        mimas_get_window_content_size(window, &x, &y);
+        if(application_context.redraw || x != rendered_width || y != rendered_height) {
+            render_frame(x, y);
+            {
+                TRACE_ZONE("swap_buffers");
+                mimas_swap_buffers(window);
             }
+            application_context.redraw = false;
+            rendered_width = x;
+            rendered_height = y;
+            last_render_time = mimas_get_time();
         }
 
-        for(Entity const entity: world.entities<Point_Mass>()) {
-            Point_Mass& point_mass = world.get_component<Point_Mass>(entity);
-            Transform& transform = world.get_component<Transform>(entity);
-            transform.postion = Vec3{point_mass.position, 0.0f};
-            f32 const scale_factor = application_context.object_scale * log2(point_mass.mass);
-            transform.scale = Vec3{scale_factor};
+        // Sleep until the next substep is due when running, otherwise until the next poll of the events.
+        // The frame rate cap delays the next frame regardless.
+        {
+            TRACE_ZONE("idle");
+            f64 const now = mimas_get_time();
+            f64 wait = idle_poll_interval;
+            if(!application_context.single_step) {
+                wait = math::min(wait, (f64)get_time_to_next_substep(*physics_world) / (f64)application_context.simulation_speed);
+            }
+            if(options.fps_cap > 0.0f) {
+                wait = math::max(wait, last_render_time + 1.0 / (f64)options.fps_cap - now);
+            }
+            if(wait > 0.0) {
+                std::this_thread::sleep_for(std::chrono::duration<f64>(wait));
+            }
         }
 
-        i32 x, y;
-        mimas_get_window_content_size(window, &x, &y);
-        f32 const aspect_ratio = (f32)x / (f32)y;
-        f32 const zoom = application_context.zoom;
+        account_frame_allocations();
+    }
 
-        Mat4 const view = lookat_rh(Vec3{application_context.camera_position, 5.0f}, Vec3{application_context.camera_position, -1.0f}, Vec3{0.0f, 1.0f, 0.0f});
-        Mat4 const proj = orthographic_rh(-aspect_ratio * zoom, aspect_ratio * zoom, -zoom, zoom, 0.0f, 10.0f);
+    if(is_tracing_enabled()) {
+        set_tracing_enabled(false);
+        if(!export_trace(trace_path)) {
+            cout.write(format(u8"failed to write the trace to {}\n", trace_path));
+        }
+    }
 
-        glViewport(0, 0, x, y);
-        render(world, view, proj);
-        mimas_swap_buffers(window);
+    cout.write(format(u8"scratch memory high water marks: physics step {} bytes, frame {} bytes\n", get_physics_arena_high_water_mark(*physics_world),
+                      get_frame_arena_high_water_mark()));
+    bool steady_state_allocated = false;
+    if(options.steady_state_frame >= 0) {
+        Allocation_Counts const total = get_allocation_total(steady_state_allocations);
+        if(total.count > 0) {
+            steady_state_allocated = true;
+            cout.write(format(u8"{} frames starting from frame {} allocated {} times, {} bytes in total\n", allocating_steady_state_frames,
+                              options.steady_state_frame, total.count, total.bytes));
+            for(i32 tag = 0; tag < allocation_tag_count; ++tag) {
+                Allocation_Counts const& counts = steady_state_allocations.tags[tag];
+                if(counts.count > 0) {
+                    cout.write(format(u8"    {}: {} allocations, {} bytes\n", get_allocation_tag_name((Allocation_Tag)tag), counts.count, counts.bytes));
+                }
+            }
+        } else {
+            cout.write(format(u8"no allocations in {} frames starting from frame {}\n", math::max(frame_index - options.steady_state_frame, (i64)0),
+                              options.steady_state_frame));
+        }
     }
 
+    destroy_timeline(timeline);
     destory_physics_world(physics_world);
     mimas_destroy_window(window);
     mimas_terminate();
 
-    return 0;
+    return steady_state_allocated ? 1 : 0;
 }
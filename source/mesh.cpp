@@ -12,6 +12,12 @@ static Array<Mesh_Resource> resources;
 static u64 handle_index_counter = 0;
 
 Handle<Mesh> add_mesh(Mesh&& mesh) {
+    f32 radius_squared = 0.0f;
+    for(Vertex const& vertex: mesh.vertices) {
+        radius_squared = math::max(radius_squared, vertex.position.x * vertex.position.x + vertex.position.y * vertex.position.y);
+    }
+    mesh.bounding_radius = math::sqrt(radius_squared);
+
     Handle<Mesh> handle{handle_index_counter++};
     resources.emplace_back(handle, ANTON_MOV(mesh));
     return handle;
@@ -4,6 +4,7 @@
 #include <anton/math/vec3.hpp>
 #include <anton/math/vec4.hpp>
 #include <build.hpp>
+#include <gravity.hpp>
 #include <handle.hpp>
 #include <shader.hpp>
 
@@ -14,11 +15,15 @@ struct Vertex {
 
 struct Mesh {
     Array<Vertex> vertices;
+    // Distance of the farthest vertex from the origin in the xy plane. Computed by add_mesh.
+    f32 bounding_radius = 0.0f;
 };
 
 struct Mesh_Renderer {
     Handle<Mesh> mesh;
     Handle<Shader> shader;
+    // Used in place of mesh when the object is small on the screen. Optional.
+    Handle<Mesh> low_detail_mesh;
 };
 
 struct Isolines {
@@ -32,6 +37,9 @@ struct Isolines {
     Handle<Mesh> mesh;
     Handle<Shader> shader;
     Render_Mode mode = Render_Mode::lines;
+    // Kernel of the drawn field. Should match the physics.
+    Softening softening = Softening::spline;
+    f32 softening_length = 1.0f;
     bool enabled = false;
 };
 
@@ -0,0 +1,127 @@
+#include <offscreen.hpp>
+
+#include <anton/array.hpp>
+#include <anton/assert.hpp>
+#include <trace.hpp>
+
+#include <glad/glad.h>
+
+#include <string.h>
+
+struct Readback {
+    u32 buffer;
+    GLsync fence = nullptr;
+    i64 frame_index = 0;
+};
+
+struct Offscreen_Target {
+    i32 width;
+    i32 height;
+    u32 framebuffer;
+    u32 color;
+    u32 depth;
+    Array<Readback> ring;
+    // Index of the oldest queued readback and the number of queued readbacks.
+    i64 first = 0;
+    i64 queued = 0;
+};
+
+Offscreen_Target* create_offscreen_target(i32 const width, i32 const height, i32 const readback_count) {
+    Offscreen_Target* const target = new Offscreen_Target;
+    target->width = width;
+    target->height = height;
+
+    glCreateRenderbuffers(1, &target->color);
+    glNamedRenderbufferStorage(target->color, GL_RGBA8, width, height);
+    glCreateRenderbuffers(1, &target->depth);
+    glNamedRenderbufferStorage(target->depth, GL_DEPTH_COMPONENT24, width, height);
+    glCreateFramebuffers(1, &target->framebuffer);
+    glNamedFramebufferRenderbuffer(target->framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target->color);
+    glNamedFramebufferRenderbuffer(target->framebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target->depth);
+    ANTON_FAIL(glCheckNamedFramebufferStatus(target->framebuffer, GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "offscreen framebuffer is incomplete");
+
+    i64 const size = (i64)width * height * 4;
+    target->ring.resize(math::max(readback_count, 1));
+    for(Readback& readback: target->ring) {
+        glCreateBuffers(1, &readback.buffer);
+        // Read back by the cpu. Mapped only once the copy has finished.
+        glNamedBufferStorage(readback.buffer, size, nullptr, GL_MAP_READ_BIT | GL_CLIENT_STORAGE_BIT);
+    }
+    return target;
+}
+
+void destroy_offscreen_target(Offscreen_Target* const target) {
+    for(Readback& readback: target->ring) {
+        if(readback.fence != nullptr) {
+            glDeleteSync(readback.fence);
+        }
+        glDeleteBuffers(1, &readback.buffer);
+    }
+    glDeleteFramebuffers(1, &target->framebuffer);
+    glDeleteRenderbuffers(1, &target->color);
+    glDeleteRenderbuffers(1, &target->depth);
+    delete target;
+}
+
+void bind_offscreen_target(Offscreen_Target& target) {
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glViewport(0, 0, target.width, target.height);
+}
+
+bool is_readback_ring_full(Offscreen_Target const& target) {
+    return target.queued == target.ring.size();
+}
+
+bool is_readback_ring_empty(Offscreen_Target const& target) {
+    return target.queued == 0;
+}
+
+void begin_readback(Offscreen_Target& target, i64 const frame_index) {
+    TRACE_ZONE("begin_readback");
+    ANTON_FAIL(!is_readback_ring_full(target), "readback ring is full");
+    Readback& readback = target.ring[(target.first + target.queued) % target.ring.size()];
+    readback.frame_index = frame_index;
+    glNamedFramebufferReadBuffer(target.framebuffer, GL_COLOR_ATTACHMENT0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target.framebuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    // With a pack buffer bound the copy happens on the gpu timeline and glReadPixels returns immediately.
+    glReadPixels(0, 0, target.width, target.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // Make sure that the fence is submitted so that waiting on it from a later call cannot deadlock.
+    glFlush();
+    target.queued += 1;
+}
+
+bool end_readback(Offscreen_Target& target, bool const wait, i64& frame_index, u8* const pixels) {
+    if(target.queued == 0) {
+        return false;
+    }
+
+    TRACE_ZONE("end_readback");
+    Readback& readback = target.ring[target.first];
+    while(true) {
+        // Waits in steps of a second.
+        GLenum const status = glClientWaitSync(readback.fence, 0, wait ? 1000000000 : 0);
+        if(status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+            break;
+        }
+
+        ANTON_FAIL(status != GL_WAIT_FAILED, "waiting for the readback failed");
+        if(!wait) {
+            return false;
+        }
+    }
+
+    glDeleteSync(readback.fence);
+    readback.fence = nullptr;
+    i64 const size = (i64)target.width * target.height * 4;
+    void const* const mapped = glMapNamedBufferRange(readback.buffer, 0, size, GL_MAP_READ_BIT);
+    memcpy(pixels, mapped, size);
+    glUnmapNamedBuffer(readback.buffer);
+    frame_index = readback.frame_index;
+    target.first = (target.first + 1) % target.ring.size();
+    target.queued -= 1;
+    return true;
+}
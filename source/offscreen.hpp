@@ -0,0 +1,45 @@
+#pragma once
+
+#include <build.hpp>
+
+struct Offscreen_Target;
+
+// create_offscreen_target
+// Creates a framebuffer with an rgba8 color and a depth attachment and a ring of
+// readback_count pixel pack buffers for asynchronous readback.
+//
+[[nodiscard]] Offscreen_Target* create_offscreen_target(i32 width, i32 height, i32 readback_count);
+void destroy_offscreen_target(Offscreen_Target* target);
+
+// bind_offscreen_target
+// Binds the framebuffer of the target for drawing and sets the viewport to its size.
+//
+void bind_offscreen_target(Offscreen_Target& target);
+
+// is_readback_ring_full
+// Returns true if every pixel pack buffer holds a readback that has not been retrieved.
+//
+[[nodiscard]] bool is_readback_ring_full(Offscreen_Target const& target);
+
+// is_readback_ring_empty
+// Returns true if no readback is waiting to be retrieved.
+//
+[[nodiscard]] bool is_readback_ring_empty(Offscreen_Target const& target);
+
+// begin_readback
+// Queues the copy of the framebuffer into the next pixel pack buffer. Does not wait
+// for the gpu. The ring must not be full.
+//
+void begin_readback(Offscreen_Target& target, i64 frame_index);
+
+// end_readback
+// Retrieves the oldest queued readback.
+//
+// Parameters:
+//   wait - wait for the gpu to finish the copy.
+// pixels - width * height * 4 bytes. The rows start from the bottom.
+//
+// Returns:
+// false if no readback is queued or, when wait is false, the copy has not finished.
+//
+bool end_readback(Offscreen_Target& target, bool wait, i64& frame_index, u8* pixels);
@@ -1,71 +1,565 @@
 #include <physics.hpp>
 
+#include <arena.hpp>
+#include <domain.hpp>
+#include <gravity.hpp>
 #include <point_mass.hpp>
+#include <quadtree.hpp>
+#include <threads.hpp>
+#include <trace.hpp>
+#include <tracer.hpp>
+#include <wisdom_holman.hpp>
 
-constexpr f32 fixed_delta_time = 1.0f / 240.0f;
-constexpr f32 gravitational_constant = 6.67408e-11f;
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// Number of bodies processed by a single task.
+constexpr i64 target_block_size = 64;
+// Number of sources summed sequentially before the partial sums are combined.
+constexpr i64 source_block_size = 256;
+// Number of interactions of a direct evaluation of the bodies sampled by the tuner.
+// Bounds the time of a tuning on large scenes.
+constexpr i64 tuning_interaction_budget = 32 * 1024 * 1024;
+constexpr i64 min_tuning_sample_size = 256;
+constexpr f32 tuning_opening_angles[] = {0.35f, 0.5f, 0.7f, 1.0f};
 
 struct Physics_World {
+    Physics_Settings settings;
     f32 delta_time = 0.0f;
+    Quadtree tree;
+    // Scratch memory of a single substep. Reset at the beginning of every substep.
+    Arena_Allocator step_arena;
+    // Created on the first step with process_count > 1.
+    Domain_Decomposition* domain_decomposition = nullptr;
+    // Largest thread count tried by the tuner. The thread_count of the settings is tuned.
+    i32 thread_limit = 1;
+    Physics_Tuning tuning;
+    // Tune before the next substep.
+    bool tuning_due = true;
+    i64 steps_since_tuning = 0;
 };
 
-Physics_World* create_physics_world() {
+bool parse_integrator(String_View const name, Integrator& integrator) {
+    if(name == u8"verlet") {
+        integrator = Integrator::verlet;
+    } else if(name == u8"wisdom_holman") {
+        integrator = Integrator::wisdom_holman;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parse_softening(String_View const name, Softening& softening) {
+    if(name == u8"plummer") {
+        softening = Softening::plummer;
+    } else if(name == u8"spline") {
+        softening = Softening::spline;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+Physics_World* create_physics_world(Physics_Settings const& settings) {
     Physics_World* physics_world = new Physics_World;
+    physics_world->settings = settings;
+    physics_world->thread_limit = settings.thread_count;
     return physics_world;
 }
 
 void destory_physics_world(Physics_World* physics_world) {
+    if(physics_world->domain_decomposition != nullptr) {
+        destroy_domain_decomposition(physics_world->domain_decomposition);
+    }
     delete physics_world;
 }
 
-void run_physics(Physics_World& physics_world, World& world, f32 const delta_time) {
+Physics_Settings get_physics_settings(Physics_World const& physics_world) {
+    return physics_world.settings;
+}
+
+void set_physics_settings(Physics_World& physics_world, Physics_Settings const& settings) {
+    // The workers hold a copy of the settings.
+    if(physics_world.domain_decomposition != nullptr) {
+        destroy_domain_decomposition(physics_world.domain_decomposition);
+        physics_world.domain_decomposition = nullptr;
+    }
+    physics_world.settings = settings;
+    physics_world.thread_limit = settings.thread_count;
+    physics_world.tuning_due = true;
+}
+
+i64 get_physics_arena_high_water_mark(Physics_World const& physics_world) {
+    return physics_world.step_arena.get_high_water_mark();
+}
+
+f32 get_time_to_next_substep(Physics_World const& physics_world) {
+    return math::max(physics_world.settings.timestep - physics_world.delta_time, 0.0f);
+}
+
+// Sum of accelerations at position exerted by the sources in the range [begin, end).
+// self is the index of the source that is the body itself. The second evaluation of a substep
+// moves the body away from its source, hence self is masked out with a select, which keeps the loop branch-free.
+template<typename Kernel>
+static Vec2 accumulate_accelerations(Slice<Point_Mass const> const sources, i64 const begin, i64 const end, Vec2 const position, i64 const self,
+                                     f32 const softening_length) {
+    Vec2 acceleration;
+    for(i64 i = begin; i < end; ++i) {
+        Point_Mass const& point_mass = sources[i];
+        f32 const mass = i != self ? point_mass.mass : 0.0f;
+        acceleration += gravitational_acceleration<Kernel>(point_mass.position, mass, position, softening_length);
+    }
+    return acceleration;
+}
+
+// Sums the sources in blocks of source_block_size and combines the block sums pairwise.
+// The order of the operations depends only on the number of sources.
+template<typename Kernel>
+static Vec2 accumulate_accelerations_pairwise(Slice<Point_Mass const> const sources, Vec2 const position, i64 const self, f32 const softening_length) {
+    // Stack of partial sums and the number of blocks they cover.
+    // 64 levels are enough for any i64 number of blocks.
+    Vec2 partials[64];
+    i64 sizes[64];
+    i64 top = 0;
+    for(i64 begin = 0; begin < sources.size(); begin += source_block_size) {
+        i64 const end = math::min(begin + source_block_size, sources.size());
+        partials[top] = accumulate_accelerations<Kernel>(sources, begin, end, position, self, softening_length);
+        sizes[top] = 1;
+        top += 1;
+        while(top >= 2 && sizes[top - 1] == sizes[top - 2]) {
+            partials[top - 2] += partials[top - 1];
+            sizes[top - 2] *= 2;
+            top -= 1;
+        }
+    }
+
+    Vec2 acceleration;
+    for(i64 i = top - 1; i >= 0; --i) {
+        acceleration += partials[i];
+    }
+    return acceleration;
+}
+
+// compute_direct_accelerations
+// Computes the accelerations at positions exerted by the sources. positions[i] is the position
+// of the body that is sources[i], therefore sources[i] does not contribute to accelerations[i].
+//
+template<typename Kernel>
+static void compute_direct_accelerations(Physics_Settings const& settings, Arena_Allocator& arena, Slice<Point_Mass const> const sources,
+                                         Slice<Vec2 const> const positions, Slice<Vec2> const accelerations) {
+    TRACE_ZONE("compute_direct_accelerations");
+    i64 const count = positions.size();
+    f32 const softening_length = settings.softening_length;
+    if(settings.deterministic) {
+        parallel_for(count, target_block_size, settings.thread_count, [sources, positions, accelerations, softening_length](i64 const begin, i64 const end) {
+            for(i64 i = begin; i < end; ++i) {
+                accelerations[i] = accumulate_accelerations_pairwise<Kernel>(sources, positions[i], i, softening_length);
+            }
+        });
+        return;
+    }
+
+    // When there are not enough bodies to keep all threads busy, the sources are split
+    // between the threads as well. The partial sums are added in the order of the splits
+    // which makes the result depend on the thread count.
+    i64 const target_blocks = (count + target_block_size - 1) / target_block_size;
+    i64 const source_blocks = (sources.size() + source_block_size - 1) / source_block_size;
+    i64 const source_splits = math::clamp(settings.thread_count / math::max(target_blocks, (i64)1), (i64)1, math::max(source_blocks, (i64)1));
+    if(source_splits == 1) {
+        parallel_for(count, target_block_size, settings.thread_count, [sources, positions, accelerations, softening_length](i64 const begin, i64 const end) {
+            for(i64 i = begin; i < end; ++i) {
+                accelerations[i] = accumulate_accelerations<Kernel>(sources, 0, sources.size(), positions[i], i, softening_length);
+            }
+        });
+        return;
+    }
+
+    i64 const split_size = (sources.size() + source_splits - 1) / source_splits;
+    Arena_Array<Vec2> partials{Polymorphic_Allocator{&arena}};
+    partials.resize(source_splits * count);
+    parallel_for(source_splits * count, target_block_size, settings.thread_count, [&](i64 const begin, i64 const end) {
+        for(i64 task = begin; task < end; ++task) {
+            i64 const split = task / count;
+            i64 const i = task % count;
+            i64 const source_begin = split * split_size;
+            i64 const source_end = math::min(source_begin + split_size, sources.size());
+            partials[task] = accumulate_accelerations<Kernel>(sources, source_begin, source_end, positions[i], i, softening_length);
+        }
+    });
+
+    for(i64 i = 0; i < count; ++i) {
+        Vec2 acceleration;
+        for(i64 split = 0; split < source_splits; ++split) {
+            acceleration += partials[split * count + i];
+        }
+        accelerations[i] = acceleration;
+    }
+}
+
+// compute_tree_accelerations
+// Same as compute_direct_accelerations, but approximates the sources with the tree built from them.
+// Every target is traversed sequentially by a single thread, hence the result never depends on the thread count.
+//
+template<typename Kernel>
+static void compute_tree_accelerations(Physics_Settings const& settings, Quadtree const& tree, Slice<Point_Mass const> const sources,
+                                       Slice<Vec2 const> const positions, Slice<Vec2> const accelerations) {
+    TRACE_ZONE("compute_tree_accelerations");
+    f32 const opening_angle = settings.opening_angle;
+    f32 const softening_length = settings.softening_length;
+    parallel_for(positions.size(), target_block_size, settings.thread_count,
+                 [&tree, sources, positions, accelerations, opening_angle, softening_length](i64 const begin, i64 const end) {
+                     for(i64 i = begin; i < end; ++i) {
+                         accelerations[i] = compute_quadtree_acceleration<Kernel>(tree, sources, positions[i], i, opening_angle, softening_length);
+                     }
+                 });
+}
+
+// prepare_solver
+// Builds the acceleration structures of the selected solver over the sources.
+//
+static void prepare_solver(Physics_World& physics_world, Slice<Point_Mass const> const sources) {
+    if(physics_world.settings.solver == Force_Solver::tree) {
+        build_quadtree(physics_world.tree, sources, physics_world.settings.leaf_size);
+    }
+}
+
+// evaluate_accelerations
+// Dispatches to the selected solver and softening kernel. prepare_solver must have been called with the same sources.
+//
+static void evaluate_accelerations(Physics_World& physics_world, Slice<Point_Mass const> const sources, Slice<Vec2 const> const positions,
+                                   Slice<Vec2> const accelerations) {
+    with_softening_kernel(physics_world.settings.softening, [&](auto const kernel) {
+        using Kernel = decltype(kernel);
+        switch(physics_world.settings.solver) {
+            case Force_Solver::direct: {
+                compute_direct_accelerations<Kernel>(physics_world.settings, physics_world.step_arena, sources, positions, accelerations);
+            } break;
+
+            case Force_Solver::tree: {
+                compute_tree_accelerations<Kernel>(physics_world.settings, physics_world.tree, sources, positions, accelerations);
+            } break;
+        }
+    });
+}
+
+void compute_accelerations(Physics_World& physics_world, Slice<Point_Mass const> const point_masses, Slice<Vec2> const accelerations) {
+    physics_world.step_arena.reset();
+    Arena_Array<Vec2> positions{Polymorphic_Allocator{&physics_world.step_arena}};
+    positions.resize(point_masses.size());
+    for(i64 i = 0; i < point_masses.size(); ++i) {
+        positions[i] = point_masses[i].position;
+    }
+
+    prepare_solver(physics_world, point_masses);
+    evaluate_accelerations(physics_world, point_masses, Slice<Vec2 const>{positions.begin(), positions.end()}, accelerations);
+}
+
+// get_domain_decomposition
+// Returns the domain decomposition with room for count bodies or nullptr if step_physics does not use one.
+//
+static Domain_Decomposition* get_domain_decomposition(Physics_World& physics_world, i64 const count) {
+    Physics_Settings const& settings = physics_world.settings;
+    if(settings.integrator == Integrator::wisdom_holman || settings.process_count <= 1 || !is_domain_decomposition_supported()) {
+        return nullptr;
+    }
+
+    Domain_Decomposition*& domain_decomposition = physics_world.domain_decomposition;
+    if(domain_decomposition != nullptr && get_domain_decomposition_capacity(*domain_decomposition) < count) {
+        destroy_domain_decomposition(domain_decomposition);
+        domain_decomposition = nullptr;
+    }
+
+    if(domain_decomposition == nullptr) {
+        domain_decomposition = create_domain_decomposition(settings, math::max(2 * count, (i64)1024), count);
+    }
+    return domain_decomposition;
+}
+
+void step_physics(Physics_World& physics_world, Slice<Point_Mass> const point_masses, i64 const step_count) {
+    if(physics_world.settings.integrator == Integrator::wisdom_holman) {
+        step_wisdom_holman(physics_world.settings, physics_world.step_arena, point_masses, step_count);
+        return;
+    }
+
+    if(Domain_Decomposition* const domain_decomposition = get_domain_decomposition(physics_world, point_masses.size())) {
+        step_domain_decomposition(*domain_decomposition, point_masses, step_count);
+        return;
+    }
+
+    f32 const timestep = physics_world.settings.timestep;
+    Slice<Point_Mass const> const sources{point_masses.begin(), point_masses.end()};
+    i64 const count = point_masses.size();
+    for(i64 step = 0; step < step_count; ++step) {
+        TRACE_ZONE("physics_substep");
+        physics_world.step_arena.reset();
+        Polymorphic_Allocator const allocator{&physics_world.step_arena};
+        Arena_Array<Vec2> positions{allocator};
+        positions.resize(count);
+        Arena_Array<Vec2> positions_next{allocator};
+        positions_next.resize(count);
+        Arena_Array<Vec2> accelerations1{allocator};
+        accelerations1.resize(count);
+        Arena_Array<Vec2> accelerations2{allocator};
+        accelerations2.resize(count);
+        for(i64 i = 0; i < count; ++i) {
+            positions[i] = point_masses[i].position;
+        }
+
+        prepare_solver(physics_world, sources);
+        // Sum of accelerations at t
+        evaluate_accelerations(physics_world, sources, Slice<Vec2 const>{positions.begin(), positions.end()},
+                               Slice<Vec2>{accelerations1.begin(), accelerations1.end()});
+        for(i64 i = 0; i < count; ++i) {
+            Point_Mass const& point_mass = point_masses[i];
+            positions_next[i] = point_mass.position + point_mass.velocity * timestep + 0.5f * accelerations1[i] * timestep * timestep;
+        }
+
+        // Sum of accelerations at t+dt. Every body is moved to its new position
+        // while the sources remain at their positions at t.
+        evaluate_accelerations(physics_world, sources, Slice<Vec2 const>{positions_next.begin(), positions_next.end()},
+                               Slice<Vec2>{accelerations2.begin(), accelerations2.end()});
+        for(i64 i = 0; i < count; ++i) {
+            Point_Mass& point_mass = point_masses[i];
+            point_mass.position = positions_next[i];
+            point_mass.velocity = point_mass.velocity + 0.5f * (accelerations1[i] + accelerations2[i]) * timestep;
+        }
+    }
+}
+
+i64 run_physics(Physics_World& physics_world, World& world, f32 const delta_time) {
+    TRACE_ZONE("run_physics");
+    f32 const timestep = physics_world.settings.timestep;
+    Slice<Point_Mass> const point_masses = world.components<Point_Mass>();
+    i64 const count = point_masses.size();
+    i64 substeps = 0;
     physics_world.delta_time += delta_time;
-    while(physics_world.delta_time >= fixed_delta_time) {
-        physics_world.delta_time -= fixed_delta_time;
-        Slice<Point_Mass> point_masses = world.components<Point_Mass>();
-        Array<Point_Mass> point_masses_next{reserve, point_masses.size()};
-        for(Point_Mass const& e: point_masses) {
-            Point_Mass point_mass_next = e;
-            // Sum of accelerations at t
-            Vec2 acceleration1;
-            for(Point_Mass const& point_mass: point_masses) {
-                // Skip self
-                if(&e == &point_mass) {
-                    continue;
-                }
+    while(physics_world.delta_time >= timestep) {
+        physics_world.delta_time -= timestep;
+        substeps += 1;
+    }
 
-                Vec2 const distance_vec = point_mass.position - point_mass_next.position;
-                f32 const distance = math::length(distance_vec);
-                if(!is_almost_zero(distance, 1.0f)) {
-                    Vec2 const direction_vec = distance_vec / distance;
-                    f32 const acceleration_magnitude = point_mass.mass / distance / distance * gravitational_constant;
-                    acceleration1 += direction_vec * acceleration_magnitude;
-                }
+    Physics_Settings const& settings = physics_world.settings;
+    bool const tunable = settings.auto_tune && settings.integrator == Integrator::verlet && settings.process_count <= 1;
+    if(tunable && substeps > 0 && count > 0 && (physics_world.tuning_due || physics_world.steps_since_tuning >= settings.tune_interval)) {
+        tune_physics(physics_world, Slice<Point_Mass const>{point_masses.begin(), point_masses.end()});
+    }
+    physics_world.steps_since_tuning += substeps;
+
+    // The tracers need the sources at the beginning of every substep.
+    Slice<Tracer_Cloud> const tracer_clouds = world.has_type<Tracer_Cloud>() ? world.components<Tracer_Cloud>() : Slice<Tracer_Cloud>{};
+    Domain_Decomposition* const domain_decomposition = tracer_clouds.size() > 0 && substeps > 0 ? get_domain_decomposition(physics_world, count) : nullptr;
+    if(domain_decomposition != nullptr) {
+        // The tracers are advanced by this process while the workers integrate the bodies.
+        step_domain_decomposition(*domain_decomposition, point_masses, substeps, [&physics_world, tracer_clouds](Slice<Point_Mass const> const sources) {
+            for(Tracer_Cloud& cloud: tracer_clouds) {
+                step_tracers(physics_world.settings, sources, cloud);
+            }
+        });
+    } else if(tracer_clouds.size() > 0) {
+        Slice<Point_Mass const> const sources{point_masses.begin(), point_masses.end()};
+        for(i64 step = 0; step < substeps; ++step) {
+            for(Tracer_Cloud& cloud: tracer_clouds) {
+                step_tracers(physics_world.settings, sources, cloud);
             }
+            step_physics(physics_world, point_masses, 1);
+        }
+    } else {
+        step_physics(physics_world, point_masses, substeps);
+    }
 
-            point_mass_next.position =
-                point_mass_next.position + point_mass_next.velocity * fixed_delta_time + 0.5 * acceleration1 * fixed_delta_time * fixed_delta_time;
+    TRACE_COUNTER("substeps", substeps);
+    if(physics_world.settings.solver == Force_Solver::direct && physics_world.settings.integrator == Integrator::verlet) {
+        // Every substep evaluates the accelerations twice for each pair.
+        TRACE_COUNTER("interactions", 2 * substeps * count * (count - 1));
+    }
+    return substeps;
+}
 
-            // Sum of accelerations at t+dt
-            Vec2 acceleration2;
-            for(Point_Mass const& point_mass: point_masses) {
-                // Skip self
-                if(&e == &point_mass) {
-                    continue;
-                }
+static f64 get_time_ms() {
+    auto const now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<f64, std::milli>(now).count();
+}
+
+// time_evaluation
+// Times the evaluation of the accelerations of the sampled bodies, which are the first
+// positions.size() sources, and extrapolates it to all sources. The faster of 2 runs is kept.
+//
+static f64 time_evaluation(Physics_World& physics_world, Slice<Point_Mass const> const sources, Slice<Vec2 const> const positions,
+                           Slice<Vec2> const accelerations) {
+    f64 best = 0.0;
+    for(i64 repetition = 0; repetition < 2; ++repetition) {
+        physics_world.step_arena.reset();
+        f64 const start = get_time_ms();
+        prepare_solver(physics_world, sources);
+        f64 const prepared = get_time_ms();
+        evaluate_accelerations(physics_world, sources, positions, accelerations);
+        f64 const end = get_time_ms();
+        f64 const time = (prepared - start) + (end - prepared) * (f64)sources.size() / (f64)positions.size();
+        best = repetition == 0 ? time : math::min(best, time);
+    }
+    return best;
+}
+
+// Same metric as the accuracy harness.
+static f64 compute_p99_error(Slice<Vec2 const> const reference, Slice<Vec2 const> const accelerations) {
+    Array<f64> errors{reserve, reference.size()};
+    for(i64 i = 0; i < reference.size(); ++i) {
+        f64 const reference_magnitude = math::length(reference[i]);
+        if(reference_magnitude > 0.0) {
+            errors.emplace_back(math::length(accelerations[i] - reference[i]) / reference_magnitude);
+        }
+    }
+
+    if(errors.size() == 0) {
+        return 0.0;
+    }
+
+    i64 const p99_index = math::min((i64)(0.99 * (f64)errors.size()), errors.size() - 1);
+    std::nth_element(errors.begin(), errors.begin() + p99_index, errors.end());
+    return errors[p99_index];
+}
+
+Physics_Tuning tune_physics(Physics_World& physics_world, Slice<Point_Mass const> const point_masses) {
+    TRACE_ZONE("tune_physics");
+    Physics_Settings& settings = physics_world.settings;
+    i64 const count = point_masses.size();
+    i64 const sample_size = math::min(math::max(tuning_interaction_budget / math::max(count, (i64)1), min_tuning_sample_size), count);
+    // Evenly spaced bodies are moved to the front, so that the sample is the first sample_size
+    // sources and every body still is its own source. The stride never reaches back into the sample.
+    Array<Point_Mass> sources{reserve, count};
+    for(Point_Mass const& point_mass: point_masses) {
+        sources.emplace_back(point_mass);
+    }
+    i64 const stride = count / math::max(sample_size, (i64)1);
+    for(i64 i = 0; i < sample_size; ++i) {
+        Point_Mass const sampled = sources[i * stride];
+        sources[i * stride] = sources[i];
+        sources[i] = sampled;
+    }
+
+    Array<Vec2> positions;
+    positions.resize(sample_size);
+    for(i64 i = 0; i < sample_size; ++i) {
+        positions[i] = sources[i].position;
+    }
+    Array<Vec2> reference;
+    reference.resize(sample_size);
+    Array<Vec2> accelerations;
+    accelerations.resize(sample_size);
+    Slice<Point_Mass const> const source_slice{sources.begin(), sources.end()};
+    Slice<Vec2 const> const position_slice{positions.begin(), positions.end()};
+    Slice<Vec2 const> const reference_slice{reference.begin(), reference.end()};
+    Slice<Vec2 const> const acceleration_slice{accelerations.begin(), accelerations.end()};
+
+    Physics_Tuning best;
+    best.thread_count = physics_world.thread_limit;
+    settings.thread_count = physics_world.thread_limit;
+    if(settings.deterministic) {
+        // The solver changes the results. Keep the one that has been selected.
+        best.solver = settings.solver;
+        best.opening_angle = settings.opening_angle;
+        best.evaluation_time = time_evaluation(physics_world, source_slice, position_slice, accelerations);
+    } else {
+        // The direct sum is the reference of the error of the tree.
+        settings.solver = Force_Solver::direct;
+        best.solver = Force_Solver::direct;
+        best.opening_angle = settings.opening_angle;
+        best.evaluation_time = time_evaluation(physics_world, source_slice, position_slice, reference);
+        settings.solver = Force_Solver::tree;
+        for(f32 const opening_angle: tuning_opening_angles) {
+            settings.opening_angle = opening_angle;
+            f64 const time = time_evaluation(physics_world, source_slice, position_slice, accelerations);
+            f64 const error = compute_p99_error(reference_slice, acceleration_slice);
+            if(error <= settings.error_budget && time < best.evaluation_time) {
+                best.solver = Force_Solver::tree;
+                best.opening_angle = opening_angle;
+                best.evaluation_time = time;
+                best.error = error;
+            }
+        }
+    }
+
+    // Small scenes do not keep many threads busy and pay for the synchronization instead.
+    settings.solver = best.solver;
+    settings.opening_angle = best.opening_angle;
+    for(i32 thread_count = 1; thread_count < physics_world.thread_limit; thread_count *= 2) {
+        settings.thread_count = thread_count;
+        f64 const time = time_evaluation(physics_world, source_slice, position_slice, accelerations);
+        if(time < best.evaluation_time) {
+            best.thread_count = thread_count;
+            best.evaluation_time = time;
+        }
+    }
+    settings.thread_count = best.thread_count;
+
+    best.generation = physics_world.tuning.generation + 1;
+    physics_world.tuning = best;
+    physics_world.tuning_due = false;
+    physics_world.steps_since_tuning = 0;
+    return best;
+}
+
+Physics_Tuning get_physics_tuning(Physics_World const& physics_world) {
+    return physics_world.tuning;
+}
 
-                Vec2 const distance_vec = point_mass.position - point_mass_next.position;
-                f32 const distance = math::length(distance_vec);
-                if(!is_almost_zero(distance, 1.0f)) {
-                    Vec2 const direction_vec = distance_vec / distance;
-                    f32 const acceleration_magnitude = point_mass.mass / distance / distance * gravitational_constant;
-                    acceleration2 += direction_vec * acceleration_magnitude;
+f64 compute_total_energy(Slice<Point_Mass const> const point_masses, i32 const thread_count, Softening const softening, f32 const softening_length) {
+    TRACE_ZONE("compute_total_energy");
+    constexpr f64 gravitational_constant_f64 = 6.67408e-11;
+    i64 const count = point_masses.size();
+    // Energy of every body is computed separately and summed sequentially afterwards
+    // so that the result does not depend on the thread count.
+    Array<f64> energies;
+    energies.resize(count);
+    with_softening_kernel(softening, [&](auto const kernel) {
+        using Kernel = decltype(kernel);
+        f64 const h = softening_length;
+        parallel_for(count, target_block_size, thread_count, [point_masses, &energies, h](i64 const begin, i64 const end) {
+            for(i64 i = begin; i < end; ++i) {
+                Point_Mass const& body = point_masses[i];
+                f64 const vx = body.velocity.x;
+                f64 const vy = body.velocity.y;
+                f64 energy = 0.5 * body.mass * (vx * vx + vy * vy);
+                // Potential energy of every pair is split evenly between both bodies.
+                // The softened potential of a body with itself is finite, but not 0, hence it is masked out.
+                for(i64 j = 0; j < point_masses.size(); ++j) {
+                    Point_Mass const& other = point_masses[j];
+                    f64 const mass = j != i ? (f64)other.mass : 0.0;
+                    f64 const dx = (f64)other.position.x - body.position.x;
+                    f64 const dy = (f64)other.position.y - body.position.y;
+                    energy += 0.5 * gravitational_constant_f64 * body.mass * mass * Kernel::get_potential(dx * dx + dy * dy, h);
                 }
+                energies[i] = energy;
             }
+        });
+    });
 
-            point_mass_next.velocity = point_mass_next.velocity + 0.5 * (acceleration1 + acceleration2) * fixed_delta_time;
-            point_masses_next.emplace_back(point_mass_next);
+    f64 energy = 0.0;
+    for(f64 const e: energies) {
+        energy += e;
+    }
+    return energy;
+}
+
+u64 hash_point_masses(Slice<Point_Mass const> const point_masses) {
+    // FNV-1a over the bit patterns.
+    u64 hash = 14695981039346656037ULL;
+    auto hash_f32 = [&hash](f32 const value) {
+        u32 const bits = __builtin_bit_cast(u32, value);
+        for(i32 i = 0; i < 4; ++i) {
+            hash ^= (bits >> (8 * i)) & 0xFF;
+            hash *= 1099511628211ULL;
         }
-        copy(point_masses_next.begin(), point_masses_next.end(), point_masses.begin());
+    };
+
+    for(Point_Mass const& point_mass: point_masses) {
+        hash_f32(point_mass.position.x);
+        hash_f32(point_mass.position.y);
+        hash_f32(point_mass.velocity.x);
+        hash_f32(point_mass.velocity.y);
+        hash_f32(point_mass.mass);
     }
+    return hash;
 }
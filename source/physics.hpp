@@ -1,13 +1,150 @@
 #pragma once
 
+#include <anton/math/vec2.hpp>
+#include <anton/slice.hpp>
+#include <anton/string_view.hpp>
+#include <gravity.hpp>
 #include <world.hpp>
 
+struct Point_Mass;
 struct Physics_World;
 
-[[nodiscard]] Physics_World* create_physics_world();
+enum struct Force_Solver {
+    // Exact sum over all pairs.
+    direct,
+    // Barnes-Hut quadtree.
+    tree,
+};
+
+enum struct Integrator {
+    // Velocity Verlet over all pairs.
+    verlet,
+    // Wisdom-Holman map around the most massive body. See step_wisdom_holman.
+    wisdom_holman,
+};
+
+struct Physics_Settings {
+    // Maximum number of threads used to evaluate the forces.
+    i32 thread_count = 1;
+    // Fix the work partitioning and the summation order so that the results
+    // are bitwise identical regardless of thread_count.
+    bool deterministic = false;
+    Force_Solver solver = Force_Solver::direct;
+    // The Wisdom-Holman integrator sums the interactions directly and ignores
+    // the solver and the domain decomposition.
+    Integrator integrator = Integrator::verlet;
+    // Barnes-Hut opening angle. Smaller values are more accurate.
+    f32 opening_angle = 0.5f;
+    // Softening of the interactions of the solvers and the tracers. See gravity.hpp.
+    Softening softening = Softening::spline;
+    // Scale length of the Plummer softening or support radius of the spline softening in meters.
+    f32 softening_length = 1.0f;
+    // Maximum number of bodies in a leaf of the tree.
+    i32 leaf_size = 8;
+    // Fixed timestep of a single substep.
+    f32 timestep = 1.0f / 240.0f;
+    // Number of worker processes of the domain decomposition. Linux only.
+    // 1 disables the decomposition.
+    i32 process_count = 1;
+    // Number of substeps between the rebalancing of the domains.
+    i64 rebalance_interval = 64;
+    // Let run_physics pick the solver and the thread count. See tune_physics.
+    bool auto_tune = false;
+    // Number of substeps between the tunings.
+    i64 tune_interval = 4096;
+    // Largest acceptable 99th percentile of the relative error of the accelerations of a tuned solver.
+    f32 error_budget = 1.0e-3f;
+};
+
+struct Physics_Tuning {
+    Force_Solver solver = Force_Solver::direct;
+    f32 opening_angle = 0.0f;
+    i32 thread_count = 1;
+    // Estimated time of a single force evaluation in milliseconds.
+    f64 evaluation_time = 0.0;
+    // 99th percentile of the relative error of the accelerations of the sampled bodies.
+    f64 error = 0.0;
+    // Number of tunings so far. 0 if the world has never been tuned.
+    i64 generation = 0;
+};
+
+// parse_integrator
+//
+// Returns:
+// true if name is one of verlet or wisdom_holman.
+//
+[[nodiscard]] bool parse_integrator(String_View name, Integrator& integrator);
+
+// parse_softening
+//
+// Returns:
+// true if name is one of plummer or spline.
+//
+[[nodiscard]] bool parse_softening(String_View name, Softening& softening);
+
+[[nodiscard]] Physics_World* create_physics_world(Physics_Settings const& settings = {});
 void destory_physics_world(Physics_World* physics_world);
 
+[[nodiscard]] Physics_Settings get_physics_settings(Physics_World const& physics_world);
+void set_physics_settings(Physics_World& physics_world, Physics_Settings const& settings);
+
+// get_physics_arena_high_water_mark
+// Largest number of bytes of scratch memory used by a single substep.
+//
+[[nodiscard]] i64 get_physics_arena_high_water_mark(Physics_World const& physics_world);
+
+// tune_physics
+// Times a force evaluation with the direct sum and with the tree at several opening angles
+// on a sample of the point masses. Then times the fastest solver whose error is within the
+// error budget at fewer threads. Switches physics_world to the fastest configuration.
+// The thread count never exceeds the thread_count of the settings given to physics_world.
+// When the settings are deterministic only the thread count is tuned, since the results
+// do not depend on it.
+//
+Physics_Tuning tune_physics(Physics_World& physics_world, Slice<Point_Mass const> point_masses);
+
+// get_physics_tuning
+// Returns the result of the latest tuning.
+//
+[[nodiscard]] Physics_Tuning get_physics_tuning(Physics_World const& physics_world);
+
+// get_time_to_next_substep
+// Simulated time by which run_physics must advance the simulation before it takes the next substep.
+//
+[[nodiscard]] f32 get_time_to_next_substep(Physics_World const& physics_world);
+
 // run_physics
-// Run n steps of physics simulation with a fixed delta time of 1/60 seconds.
+// Advances the simulation by delta_time in substeps of the fixed timestep.
+// The remainder is carried over to the following call.
+// With auto_tune the solver is tuned before the first substep and every tune_interval substeps.
+// Only the verlet integrator without the domain decomposition is tuned.
+// The Tracer_Clouds of the world, if the type is registered, are advanced along.
+//
+// Returns:
+// The number of substeps taken.
+//
+i64 run_physics(Physics_World& physics_world, World& world, f32 delta_time);
+
+// step_physics
+// Advances the point masses by exactly step_count substeps of the fixed timestep.
+// The same initial state and settings always produce the same result.
+//
+void step_physics(Physics_World& physics_world, Slice<Point_Mass> point_masses, i64 step_count);
+
+// compute_accelerations
+// Computes the accelerations of the point masses at their current positions
+// using the solver selected in the settings of physics_world.
+//
+void compute_accelerations(Physics_World& physics_world, Slice<Point_Mass const> point_masses, Slice<Vec2> accelerations);
+
+// compute_total_energy
+// Computes the sum of the kinetic and potential energies of the point masses
+// exactly in double precision. The potential is softened in the same way as the forces.
+//
+[[nodiscard]] f64 compute_total_energy(Slice<Point_Mass const> point_masses, i32 thread_count, Softening softening, f32 softening_length);
+
+// hash_point_masses
+// Computes a hash of the exact bit patterns of the state of the point masses.
+// Used to compare runs against each other.
 //
-void run_physics(Physics_World& physics_world, World& world, f32 delta_time);
+[[nodiscard]] u64 hash_point_masses(Slice<Point_Mass const> point_masses);
@@ -0,0 +1,305 @@
+#include <quadtree.hpp>
+
+#include <gravity.hpp>
+#include <point_mass.hpp>
+#include <trace.hpp>
+
+// Deeper nodes would be smaller than the precision of f32 positions.
+constexpr i64 max_depth = 48;
+
+// Moves the indices for which predicate is true to the front of the range.
+// Returns the index of the first element for which predicate is false.
+template<typename Predicate>
+static i64 partition_indices(Array<i64>& indices, i64 begin, i64 end, Predicate const& predicate) {
+    while(true) {
+        while(begin < end && predicate(indices[begin])) {
+            ++begin;
+        }
+
+        while(begin < end && !predicate(indices[end - 1])) {
+            --end;
+        }
+
+        if(begin >= end) {
+            return begin;
+        }
+
+        i64 const index = indices[begin];
+        indices[begin] = indices[end - 1];
+        indices[end - 1] = index;
+        ++begin;
+        --end;
+    }
+}
+
+static void build_node(Quadtree& tree, Slice<Point_Mass const> const point_masses, i64 const node_index, i64 const leaf_size, i64 const depth) {
+    Quadtree_Node node = tree.nodes[node_index];
+    // Accumulate in double precision. The products of masses and positions easily overflow f32.
+    f64 mass = 0.0;
+    f64 weighted_x = 0.0;
+    f64 weighted_y = 0.0;
+    for(i64 i = node.begin; i < node.end; ++i) {
+        Point_Mass const& point_mass = point_masses[tree.indices[i]];
+        mass += point_mass.mass;
+        weighted_x += (f64)point_mass.position.x * point_mass.mass;
+        weighted_y += (f64)point_mass.position.y * point_mass.mass;
+    }
+
+    node.mass = mass;
+    node.center_of_mass = mass > 0.0 ? Vec2{(f32)(weighted_x / mass), (f32)(weighted_y / mass)} : node.center;
+    node.first_child = -1;
+    if(node.end - node.begin > leaf_size && depth < max_depth) {
+        // Split into quadrants in the order (-x, -y), (+x, -y), (-x, +y), (+x, +y).
+        Vec2 const center = node.center;
+        auto below = [point_masses, center](i64 const index) { return point_masses[index].position.y < center.y; };
+        auto left = [point_masses, center](i64 const index) { return point_masses[index].position.x < center.x; };
+        i64 const split_y = partition_indices(tree.indices, node.begin, node.end, below);
+        i64 const split_x_bottom = partition_indices(tree.indices, node.begin, split_y, left);
+        i64 const split_x_top = partition_indices(tree.indices, split_y, node.end, left);
+        i64 const bounds[5] = {node.begin, split_x_bottom, split_y, split_x_top, node.end};
+
+        f32 const quarter_size = 0.5f * node.half_size;
+        node.first_child = tree.nodes.size();
+        for(i64 child = 0; child < 4; ++child) {
+            Vec2 const offset{child & 1 ? quarter_size : -quarter_size, child & 2 ? quarter_size : -quarter_size};
+            tree.nodes.emplace_back(Quadtree_Node{center + offset, quarter_size, Vec2{}, 0.0f, -1, bounds[child], bounds[child + 1]});
+        }
+    }
+    // Write back before recursing. Recursion may reallocate the nodes.
+    tree.nodes[node_index] = node;
+
+    if(node.first_child != -1) {
+        for(i64 child = 0; child < 4; ++child) {
+            build_node(tree, point_masses, node.first_child + child, leaf_size, depth + 1);
+        }
+    }
+}
+
+void build_quadtree(Quadtree& tree, Slice<Point_Mass const> const point_masses, i64 const leaf_size) {
+    TRACE_ZONE("build_quadtree");
+    i64 const count = point_masses.size();
+    tree.nodes.clear();
+    tree.indices.resize(count);
+    tree.ranks.resize(count);
+    for(i64 i = 0; i < count; ++i) {
+        tree.indices[i] = i;
+    }
+
+    Vec2 min_bound{0.0f, 0.0f};
+    Vec2 max_bound{0.0f, 0.0f};
+    if(count > 0) {
+        min_bound = point_masses[0].position;
+        max_bound = point_masses[0].position;
+    }
+
+    for(Point_Mass const& point_mass: point_masses) {
+        min_bound.x = math::min(min_bound.x, point_mass.position.x);
+        min_bound.y = math::min(min_bound.y, point_mass.position.y);
+        max_bound.x = math::max(max_bound.x, point_mass.position.x);
+        max_bound.y = math::max(max_bound.y, point_mass.position.y);
+    }
+
+    Vec2 const extent = max_bound - min_bound;
+    // Pad the root slightly so that no body lies exactly on its boundary.
+    f32 const half_size = 0.5f * math::max(extent.x, extent.y) * 1.001f + 1.0f;
+    tree.nodes.emplace_back(Quadtree_Node{0.5f * (min_bound + max_bound), half_size, Vec2{}, 0.0f, -1, 0, count});
+    build_node(tree, point_masses, 0, leaf_size, 0);
+
+    for(i64 i = 0; i < count; ++i) {
+        tree.ranks[tree.indices[i]] = i;
+    }
+}
+
+template<typename Kernel>
+Vec2 compute_quadtree_acceleration(Quadtree const& tree, Slice<Point_Mass const> const point_masses, Vec2 const position, i64 const self,
+                                   f32 const opening_angle, f32 const softening_length) {
+    Vec2 acceleration;
+    if(tree.nodes.size() == 0) {
+        return acceleration;
+    }
+
+    i64 const self_rank = tree.ranks[self];
+    Point_Mass const& self_point_mass = point_masses[self];
+    f32 const opening_angle_squared = opening_angle * opening_angle;
+    // Every level pushes at most 4 nodes and pops 1.
+    i64 stack[4 * max_depth + 4];
+    i64 top = 0;
+    stack[top++] = 0;
+    while(top > 0) {
+        Quadtree_Node const& node = tree.nodes[stack[--top]];
+        if(node.begin == node.end) {
+            continue;
+        }
+
+        if(node.first_child == -1) {
+            for(i64 i = node.begin; i < node.end; ++i) {
+                i64 const index = tree.indices[i];
+                Point_Mass const& point_mass = point_masses[index];
+                // Self is masked out rather than skipped, which keeps the loop branch-free.
+                f32 const mass = index != self ? point_mass.mass : 0.0f;
+                acceleration += gravitational_acceleration<Kernel>(point_mass.position, mass, position, softening_length);
+            }
+            continue;
+        }
+
+        Vec2 const offset = position - node.center;
+        bool const inside = math::abs(offset.x) <= node.half_size && math::abs(offset.y) <= node.half_size;
+        f32 const size = 2.0f * node.half_size;
+        Vec2 const distance_vec = node.center_of_mass - position;
+        f32 const distance_squared = math::dot(distance_vec, distance_vec);
+        if(!inside && size * size < opening_angle_squared * distance_squared) {
+            if(self_rank >= node.begin && self_rank < node.end) {
+                // Remove self from the node's center of mass.
+                f32 const mass = node.mass - self_point_mass.mass;
+                if(mass > 0.0f) {
+                    f64 const x = ((f64)node.center_of_mass.x * node.mass - (f64)self_point_mass.position.x * self_point_mass.mass) / mass;
+                    f64 const y = ((f64)node.center_of_mass.y * node.mass - (f64)self_point_mass.position.y * self_point_mass.mass) / mass;
+                    Vec2 const center_of_mass{(f32)x, (f32)y};
+                    acceleration += gravitational_acceleration<Kernel>(center_of_mass, mass, position, softening_length);
+                }
+            } else {
+                acceleration += gravitational_acceleration<Kernel>(node.center_of_mass, node.mass, position, softening_length);
+            }
+        } else {
+            for(i64 child = 0; child < 4; ++child) {
+                stack[top++] = node.first_child + child;
+            }
+        }
+    }
+    return acceleration;
+}
+
+template Vec2 compute_quadtree_acceleration<Plummer_Softening>(Quadtree const& tree, Slice<Point_Mass const> point_masses, Vec2 position, i64 self,
+                                                                f32 opening_angle, f32 softening_length);
+template Vec2 compute_quadtree_acceleration<Spline_Softening>(Quadtree const& tree, Slice<Point_Mass const> point_masses, Vec2 position, i64 self,
+                                                               f32 opening_angle, f32 softening_length);
+
+// Squared distance from position to the square of the node. 0 inside of it.
+static f32 get_node_distance_squared(Quadtree_Node const& node, Vec2 const position) {
+    f32 const dx = math::max(math::abs(position.x - node.center.x) - node.half_size, 0.0f);
+    f32 const dy = math::max(math::abs(position.y - node.center.y) - node.half_size, 0.0f);
+    return dx * dx + dy * dy;
+}
+
+i64 find_nearest_in_quadtree(Quadtree const& tree, Slice<Point_Mass const> const point_masses, Vec2 const position, f32 const max_distance) {
+    i64 nearest = -1;
+    f32 nearest_distance_squared = max_distance * max_distance;
+    if(tree.nodes.size() == 0) {
+        return nearest;
+    }
+
+    i64 stack[4 * max_depth + 4];
+    i64 top = 0;
+    stack[top++] = 0;
+    while(top > 0) {
+        Quadtree_Node const& node = tree.nodes[stack[--top]];
+        if(node.begin == node.end || get_node_distance_squared(node, position) > nearest_distance_squared) {
+            continue;
+        }
+
+        if(node.first_child == -1) {
+            for(i64 i = node.begin; i < node.end; ++i) {
+                i64 const index = tree.indices[i];
+                Vec2 const offset = point_masses[index].position - position;
+                f32 const distance_squared = math::dot(offset, offset);
+                if(distance_squared <= nearest_distance_squared) {
+                    nearest = index;
+                    nearest_distance_squared = distance_squared;
+                }
+            }
+            continue;
+        }
+
+        // Push the farthest child first so that the nearest one is visited first and shrinks the search radius.
+        i64 children[4];
+        f32 distances[4];
+        for(i64 child = 0; child < 4; ++child) {
+            i64 j = child;
+            f32 const distance = get_node_distance_squared(tree.nodes[node.first_child + child], position);
+            for(; j > 0 && distances[j - 1] < distance; --j) {
+                children[j] = children[j - 1];
+                distances[j] = distances[j - 1];
+            }
+            children[j] = node.first_child + child;
+            distances[j] = distance;
+        }
+        for(i64 child = 0; child < 4; ++child) {
+            stack[top++] = children[child];
+        }
+    }
+    return nearest;
+}
+
+void query_quadtree_radius(Quadtree const& tree, Slice<Point_Mass const> const point_masses, Vec2 const position, f32 const radius, Array<i64>& result) {
+    if(tree.nodes.size() == 0) {
+        return;
+    }
+
+    f32 const radius_squared = radius * radius;
+    i64 stack[4 * max_depth + 4];
+    i64 top = 0;
+    stack[top++] = 0;
+    while(top > 0) {
+        Quadtree_Node const& node = tree.nodes[stack[--top]];
+        if(node.begin == node.end || get_node_distance_squared(node, position) > radius_squared) {
+            continue;
+        }
+
+        // The farthest corner is within the radius, hence every body of the node is.
+        f32 const far_x = math::abs(position.x - node.center.x) + node.half_size;
+        f32 const far_y = math::abs(position.y - node.center.y) + node.half_size;
+        if(far_x * far_x + far_y * far_y <= radius_squared) {
+            for(i64 i = node.begin; i < node.end; ++i) {
+                result.emplace_back(tree.indices[i]);
+            }
+        } else if(node.first_child == -1) {
+            for(i64 i = node.begin; i < node.end; ++i) {
+                i64 const index = tree.indices[i];
+                Vec2 const offset = point_masses[index].position - position;
+                if(math::dot(offset, offset) <= radius_squared) {
+                    result.emplace_back(index);
+                }
+            }
+        } else {
+            for(i64 child = 0; child < 4; ++child) {
+                stack[top++] = node.first_child + child;
+            }
+        }
+    }
+}
+
+void query_quadtree_rectangle(Quadtree const& tree, Slice<Point_Mass const> const point_masses, Vec2 const min, Vec2 const max, Array<i64>& result) {
+    if(tree.nodes.size() == 0) {
+        return;
+    }
+
+    i64 stack[4 * max_depth + 4];
+    i64 top = 0;
+    stack[top++] = 0;
+    while(top > 0) {
+        Quadtree_Node const& node = tree.nodes[stack[--top]];
+        Vec2 const node_min = node.center - Vec2{node.half_size, node.half_size};
+        Vec2 const node_max = node.center + Vec2{node.half_size, node.half_size};
+        if(node.begin == node.end || node_max.x < min.x || node_min.x > max.x || node_max.y < min.y || node_min.y > max.y) {
+            continue;
+        }
+
+        if(node_min.x >= min.x && node_max.x <= max.x && node_min.y >= min.y && node_max.y <= max.y) {
+            for(i64 i = node.begin; i < node.end; ++i) {
+                result.emplace_back(tree.indices[i]);
+            }
+        } else if(node.first_child == -1) {
+            for(i64 i = node.begin; i < node.end; ++i) {
+                i64 const index = tree.indices[i];
+                Vec2 const position = point_masses[index].position;
+                if(position.x >= min.x && position.x <= max.x && position.y >= min.y && position.y <= max.y) {
+                    result.emplace_back(index);
+                }
+            }
+        } else {
+            for(i64 child = 0; child < 4; ++child) {
+                stack[top++] = node.first_child + child;
+            }
+        }
+    }
+}
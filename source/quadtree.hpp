@@ -0,0 +1,70 @@
+#pragma once
+
+#include <anton/array.hpp>
+#include <anton/math/vec2.hpp>
+#include <anton/slice.hpp>
+#include <build.hpp>
+
+struct Point_Mass;
+
+struct Quadtree_Node {
+    // Center of the square covered by the node.
+    Vec2 center;
+    f32 half_size;
+    Vec2 center_of_mass;
+    f32 mass;
+    // Index of the first of the 4 consecutive children or -1 if the node is a leaf.
+    i64 first_child;
+    // Range of Quadtree::indices covered by the node.
+    i64 begin;
+    i64 end;
+};
+
+struct Quadtree {
+    Array<Quadtree_Node> nodes;
+    // Indices of the bodies ordered so that every node covers a contiguous range.
+    Array<i64> indices;
+    // Position of every body in indices.
+    Array<i64> ranks;
+};
+
+// build_quadtree
+// Rebuilds the tree over the point masses reusing the memory of the previous tree.
+//
+// Parameters:
+// leaf_size - maximum number of bodies in a leaf. Leaves at the maximum depth may contain more.
+//
+void build_quadtree(Quadtree& tree, Slice<Point_Mass const> point_masses, i64 leaf_size);
+
+// compute_quadtree_acceleration
+// Barnes-Hut approximation of the acceleration at position exerted by all point masses except self.
+// A node is approximated by its center of mass when its size divided by the distance is below
+// opening_angle and position lies outside of the node.
+//
+// Parameters:
+// Kernel       - softening kernel of gravity.hpp. Instantiated for Plummer_Softening and Spline_Softening.
+// point_masses - the point masses the tree has been built from.
+//
+template<typename Kernel>
+[[nodiscard]] Vec2 compute_quadtree_acceleration(Quadtree const& tree, Slice<Point_Mass const> point_masses, Vec2 position, i64 self, f32 opening_angle,
+                                                 f32 softening_length);
+
+// find_nearest_in_quadtree
+//
+// Parameters:
+// point_masses - the point masses the tree has been built from.
+//
+// Returns:
+// The index of the point mass closest to position not farther than max_distance or -1 if there is none.
+//
+[[nodiscard]] i64 find_nearest_in_quadtree(Quadtree const& tree, Slice<Point_Mass const> point_masses, Vec2 position, f32 max_distance);
+
+// query_quadtree_radius
+// Appends the indices of the point masses within radius of position to result in no particular order.
+//
+void query_quadtree_radius(Quadtree const& tree, Slice<Point_Mass const> point_masses, Vec2 position, f32 radius, Array<i64>& result);
+
+// query_quadtree_rectangle
+// Appends the indices of the point masses inside of the rectangle [min, max] to result in no particular order.
+//
+void query_quadtree_rectangle(Quadtree const& tree, Slice<Point_Mass const> point_masses, Vec2 min, Vec2 max, Array<i64>& result);
@@ -4,9 +4,14 @@
 #include <anton/math/transform.hpp>
 #include <anton/math/vec2.hpp>
 #include <anton/string.hpp>
+#include <arena.hpp>
 #include <mesh.hpp>
 #include <point_mass.hpp>
+#include <trace.hpp>
+#include <tracer.hpp>
+#include <trails.hpp>
 #include <transform.hpp>
+#include <upload_ring.hpp>
 
 #include <glad/glad.h>
 
@@ -89,15 +94,84 @@ struct Buffer {
     void* mapped;
 };
 
-static Buffer vbo;
-static Buffer point_mass_objects_buffer;
+// Number of frames that the cpu may prepare while the gpu has not finished the first of them.
+constexpr i32 frames_in_flight = 3;
+
 static u32 vao;
+// Meshes drawn with an instance per body. Binding 0 are the vertices, binding 1 the model matrices.
+static u32 mesh_vao;
+// Everything that is written every frame: the frame constants, the vertices, the model matrices,
+// the positions of the tracers and the point mass objects of the isolines. Grows to the largest frame.
+static Upload_Ring* upload_ring = nullptr;
+static i64 shader_storage_alignment = 256;
+static i64 uniform_buffer_alignment = 256;
+static u32 tracer_vao;
+// One ring of vertices per body. The trails persist between frames, hence there is a buffer
+// per frame in flight. Only the vertices written since a buffer was last drawn are written to it.
+static Array<Vec2> trail_vertices;
+static Buffer trail_buffers[frames_in_flight];
+static i64 trail_buffer_capacities[frames_in_flight] = {};
+// Number of the call to render_trails that last wrote each buffer.
+static i64 trail_buffer_updates[frames_in_flight] = {-1, -1, -1};
+// The vertices written by the latest frames_in_flight calls to render_trails indexed by the call modulo frames_in_flight.
+static Array<i64> trail_written_vertices[frames_in_flight];
+static i64 trail_update_count = 0;
+// The latest call to render_trails that wrote every vertex.
+static i64 trail_full_update = -1;
+static u32 trail_vao;
+static Handle<Shader> point_shader;
+// Scratch memory of a single frame. Reset at the beginning of render.
+static Arena_Allocator frame_arena;
+
+constexpr i64 initial_upload_region_size = 8 * 1024 * 1024;
+
+// Level of detail thresholds in terms of the radius of a body on the screen in pixels.
+// Bodies smaller than point_radius are merged into clusters.
+constexpr f32 full_detail_radius = 6.0f;
+constexpr f32 low_detail_radius = 1.5f;
+constexpr f32 point_radius = 0.5f;
+constexpr f32 sprite_size = 2.0f;
+// Size of the screen cells in which the sub-pixel bodies are clustered in pixels.
+constexpr i64 cluster_cell_size = 4;
+// Number of bodies in a cluster at which it becomes fully opaque.
+constexpr i64 cluster_saturation_count = 8;
+
+struct Cluster_Cell {
+    // Sum of the positions relative to the lower corner of the view.
+    Vec2 offset_sum;
+    Vec4 color;
+    i64 count;
+};
 
 struct Point_Mass_Object {
     alignas(8) Vec2 position;
     alignas(8) f32 mass;
 };
 
+// The Frame uniform block of the shaders in the std140 layout. Bound to binding 0 for the whole frame.
+struct Frame_Constants {
+    Mat4 vp;
+    f32 max_field = 0.0f;
+    i32 render_mode = 0;
+    f32 softening_length = 1.0f;
+    i32 softening = 0;
+};
+
+// The instances of a mesh drawn with a shader in a single draw call.
+struct Mesh_Batch {
+    Handle<Shader> shader;
+    Handle<Mesh> mesh;
+    i64 vertex_count;
+    i64 first_vertex;
+    i64 instance_count;
+    i64 first_instance;
+};
+
+struct Mesh_Instance {
+    i64 batch;
+    Mat4 model;
+};
+
 void init_rendering() {
     install_debug_callback();
 
@@ -106,6 +180,7 @@ void init_rendering() {
     glEnable(GL_CULL_FACE);
     glEnable(GL_DEPTH_TEST);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_PROGRAM_POINT_SIZE);
     glClearColor(0, 0, 0, 1);
 
     glGenVertexArrays(1, &vao);
@@ -117,67 +192,454 @@ void init_rendering() {
     glVertexAttribFormat(1, 4, GL_FLOAT, false, offsetof(Vertex, color));
     glVertexAttribBinding(1, 0);
 
-    glCreateBuffers(1, &vbo.handle);
-    // Allocate 0.5MB of memory for the vertices. More than we will ever need.
-    glNamedBufferStorage(vbo.handle, 32768 * sizeof(Vertex), nullptr, GL_DYNAMIC_STORAGE_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
-    vbo.mapped = glMapNamedBufferRange(vbo.handle, 0, 32768 * sizeof(Vertex), GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
-    glBindVertexBuffer(0, vbo.handle, 0, sizeof(Vertex));
-
-    glCreateBuffers(1, &point_mass_objects_buffer.handle);
-    // Allocate space for 32768 mass objects.
-    glNamedBufferStorage(point_mass_objects_buffer.handle, 32768 * sizeof(Point_Mass_Object), nullptr,
-                         GL_DYNAMIC_STORAGE_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
-    point_mass_objects_buffer.mapped = glMapNamedBufferRange(point_mass_objects_buffer.handle, 0, 32768 * sizeof(Point_Mass_Object),
-                                                             GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
-    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, point_mass_objects_buffer.handle, 0, 32768 * sizeof(Point_Mass_Object));
+    glGenVertexArrays(1, &mesh_vao);
+    glBindVertexArray(mesh_vao);
+    glEnableVertexAttribArray(0);
+    glVertexAttribFormat(0, 3, GL_FLOAT, false, offsetof(Vertex, position));
+    glVertexAttribBinding(0, 0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribFormat(1, 4, GL_FLOAT, false, offsetof(Vertex, color));
+    glVertexAttribBinding(1, 0);
+    // The model matrix takes the attributes 2 to 5, a column each.
+    for(u32 column = 0; column < 4; ++column) {
+        glEnableVertexAttribArray(2 + column);
+        glVertexAttribFormat(2 + column, 4, GL_FLOAT, false, column * sizeof(Vec4));
+        glVertexAttribBinding(2 + column, 1);
+    }
+    glVertexBindingDivisor(1, 1);
+
+    upload_ring = create_upload_ring(frames_in_flight, initial_upload_region_size);
+    i32 alignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    shader_storage_alignment = math::max((i64)alignment, (i64)16);
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    uniform_buffer_alignment = math::max((i64)alignment, (i64)16);
+
+    // The tracers only have positions. The color is the constant value of the disabled attribute 1.
+    glGenVertexArrays(1, &tracer_vao);
+    glBindVertexArray(tracer_vao);
+    glEnableVertexAttribArray(0);
+    glVertexAttribFormat(0, 2, GL_FLOAT, false, 0);
+    glVertexAttribBinding(0, 0);
+    glGenVertexArrays(1, &trail_vao);
+    glBindVertexArray(trail_vao);
+    glEnableVertexAttribArray(0);
+    glVertexAttribFormat(0, 2, GL_FLOAT, false, 0);
+    glVertexAttribBinding(0, 0);
+    glBindVertexArray(vao);
+}
+
+void set_point_shader(Handle<Shader> const& shader) {
+    point_shader = shader;
+}
+
+// Returns true if the buffer has been reallocated and its contents are lost.
+static bool reserve_trail_buffer(i32 const slot, i64 const count) {
+    Buffer& buffer = trail_buffers[slot];
+    i64& capacity = trail_buffer_capacities[slot];
+    if(count <= capacity) {
+        return false;
+    }
+
+    if(capacity > 0) {
+        glUnmapNamedBuffer(buffer.handle);
+        glDeleteBuffers(1, &buffer.handle);
+    }
+
+    capacity = math::max(count, 2 * capacity);
+    i64 const size = capacity * sizeof(Vec2);
+    glCreateBuffers(1, &buffer.handle);
+    glNamedBufferStorage(buffer.handle, size, nullptr, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+    buffer.mapped = glMapNamedBufferRange(buffer.handle, 0, size, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+    return true;
+}
+
+// Writes the new points of the trails and draws all trails with a single call.
+// Returns the number of bytes uploaded.
+static i64 render_trails(Orbit_Trails& trails) {
+    TRACE_ZONE("render_trails");
+    i64 const vertex_count = get_orbit_trail_vertex_count(trails);
+    if(vertex_count == 0 || !point_shader) {
+        return 0;
+    }
+
+    // The trails are written to the cpu copy first and from there to the buffer of the frame.
+    i64 const update = trail_update_count;
+    trail_update_count += 1;
+    bool const resized = trail_vertices.size() != vertex_count;
+    if(resized) {
+        trail_vertices.resize(vertex_count);
+    }
+    bool const full_update = resized || trails.upload_all;
+    if(full_update) {
+        trail_full_update = update;
+    }
+    Array<i64>& written_vertices = trail_written_vertices[update % frames_in_flight];
+    written_vertices.clear();
+    write_orbit_trail_vertices(trails, trail_vertices.data(), resized, full_update ? nullptr : &written_vertices);
+
+    // The gpu has finished the last frame that used the buffer of the slot.
+    i32 const slot = get_upload_frame_slot(*upload_ring);
+    bool const reallocated = reserve_trail_buffer(slot, vertex_count);
+    Vec2* const vertices = (Vec2*)trail_buffers[slot].mapped;
+    i64 const previous_update = trail_buffer_updates[slot];
+    i64 written = 0;
+    // Everything is rewritten when the buffer missed a full update or more updates than the written vertices are kept for.
+    if(reallocated || previous_update < trail_full_update || previous_update < update - frames_in_flight) {
+        copy(trail_vertices.begin(), trail_vertices.end(), vertices);
+        written = vertex_count;
+    } else {
+        for(i64 i = previous_update + 1; i <= update; ++i) {
+            for(i64 const vertex: trail_written_vertices[i % frames_in_flight]) {
+                vertices[vertex] = trail_vertices[vertex];
+            }
+            written += trail_written_vertices[i % frames_in_flight].size();
+        }
+    }
+    trail_buffer_updates[slot] = update;
+
+    Polymorphic_Allocator const allocator{&frame_arena};
+    Arena_Array<i32> firsts{allocator};
+    firsts.resize(2 * trails.bodies.size());
+    Arena_Array<i32> counts{allocator};
+    counts.resize(2 * trails.bodies.size());
+    i64 const strip_count = get_orbit_trail_strips(trails, firsts.data(), counts.data());
+    if(strip_count > 0) {
+        glVertexArrayVertexBuffer(trail_vao, 0, trail_buffers[slot].handle, 0, sizeof(Vec2));
+        glBindVertexArray(trail_vao);
+        glEnable(GL_BLEND);
+        bind_shader(point_shader);
+        glVertexAttrib4f(1, trails.color.x, trails.color.y, trails.color.z, trails.color.w);
+        glMultiDrawArrays(GL_LINE_STRIP, firsts.data(), counts.data(), strip_count);
+        glDisable(GL_BLEND);
+        glBindVertexArray(vao);
+    }
+
+    TRACE_COUNTER("trail_vertices_written", written);
+    return written * sizeof(Vec2);
 }
 
-void render(World& world, Mat4 const& view, Mat4 const& proj) {
+// Draws every Tracer_Cloud as points. Returns the number of bytes uploaded.
+static i64 render_tracers(World& world) {
+    TRACE_ZONE("render_tracers");
+    i64 total_count = 0;
+    for(Tracer_Cloud const& cloud: world.components<Tracer_Cloud>()) {
+        total_count += get_tracer_count(cloud);
+    }
+
+    if(total_count == 0 || !point_shader) {
+        return 0;
+    }
+
+    Upload_Allocation const allocation = allocate_upload(*upload_ring, total_count * sizeof(Vec2), alignof(Vec2));
+    glVertexArrayVertexBuffer(tracer_vao, 0, allocation.buffer, allocation.offset, sizeof(Vec2));
+    glBindVertexArray(tracer_vao);
+    glEnable(GL_BLEND);
+    bind_shader(point_shader);
+    Vec2* const positions = (Vec2*)allocation.mapped;
+    i64 offset = 0;
+    for(Tracer_Cloud const& cloud: world.components<Tracer_Cloud>()) {
+        i64 const count = get_tracer_count(cloud);
+        for(i64 i = 0; i < count; ++i) {
+            positions[offset + i] = Vec2{cloud.position_x[i], cloud.position_y[i]};
+        }
+
+        glVertexAttrib4f(1, cloud.color.x, cloud.color.y, cloud.color.z, cloud.color.w);
+        set_uniform_f32(point_shader, "point_size", cloud.point_size);
+        glDrawArrays(GL_POINTS, offset, count);
+        offset += count;
+    }
+    glDisable(GL_BLEND);
+    glBindVertexArray(vao);
+    TRACE_COUNTER("tracers", total_count);
+    return total_count * sizeof(Vec2);
+}
+
+// Writes the point mass objects read by the isolines shader and binds them to binding 1.
+// Returns the number of bytes uploaded.
+static i64 upload_point_mass_objects(World& world, f32& max_field_value) {
+    TRACE_ZONE("upload_point_mass_objects");
+    Slice<Point_Mass> const point_masses = world.components<Point_Mass>();
+    // A range of the shader storage may not be empty.
+    i64 const objects_size = math::max(point_masses.size(), (i64)1) * sizeof(Point_Mass_Object);
+    Upload_Allocation const allocation = allocate_upload(*upload_ring, objects_size, shader_storage_alignment);
+    Point_Mass_Object* point_mass_objects = (Point_Mass_Object*)allocation.mapped;
+    if(point_masses.size() == 0) {
+        *point_mass_objects = Point_Mass_Object{};
+    }
+    max_field_value = 0.0f;
+    for(Point_Mass const& v: point_masses) {
+        point_mass_objects->position = v.position;
+        point_mass_objects->mass = v.mass;
+        point_mass_objects += 1;
+        // at distance 1.0 from the mass
+        max_field_value = math::max(max_field_value, gravitational_constant * v.mass);
+    }
+
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, allocation.buffer, allocation.offset, objects_size);
+    return point_masses.size() * sizeof(Point_Mass_Object);
+}
+
+// Draws the batches ordered by the shader and then by the mesh, so that the program changes
+// at most once per shader and every mesh is drawn with a single instanced call.
+// Returns the number of bytes uploaded.
+static i64 draw_mesh_batches(Slice<Mesh_Batch> const batches, Slice<Mesh_Instance const> const instances) {
+    TRACE_ZONE("draw_mesh_batches");
+    Polymorphic_Allocator const allocator{&frame_arena};
+    auto const precedes = [&batches](i64 const lhs, i64 const rhs) {
+        Mesh_Batch const& a = batches[lhs];
+        Mesh_Batch const& b = batches[rhs];
+        return a.shader < b.shader || (a.shader == b.shader && a.mesh < b.mesh);
+    };
+    // There are few batches, hence the insertion sort.
+    Arena_Array<i64> order{allocator};
+    for(i64 i = 0; i < batches.size(); ++i) {
+        order.emplace_back(i);
+        for(i64 j = order.size() - 1; j > 0 && precedes(order[j], order[j - 1]); --j) {
+            i64 const previous = order[j - 1];
+            order[j - 1] = order[j];
+            order[j] = previous;
+        }
+    }
+
+    i64 vertex_count = 0;
+    i64 instance_count = 0;
+    for(i64 const index: order) {
+        Mesh_Batch& batch = batches[index];
+        batch.first_vertex = vertex_count;
+        batch.first_instance = instance_count;
+        vertex_count += batch.vertex_count;
+        instance_count += batch.instance_count;
+    }
+
+    Upload_Allocation const vertex_allocation = allocate_upload(*upload_ring, vertex_count * sizeof(Vertex), 16);
+    Vertex* const vertices = (Vertex*)vertex_allocation.mapped;
+    for(Mesh_Batch const& batch: batches) {
+        Mesh const& mesh = get_mesh(batch.mesh);
+        copy(mesh.vertices.begin(), mesh.vertices.end(), vertices + batch.first_vertex);
+    }
+
+    // Counting sort of the instances by their batch.
+    Upload_Allocation const instance_allocation = allocate_upload(*upload_ring, instance_count * sizeof(Mat4), 16);
+    Mat4* const models = (Mat4*)instance_allocation.mapped;
+    Arena_Array<i64> next_instance{allocator};
+    for(Mesh_Batch const& batch: batches) {
+        next_instance.emplace_back(batch.first_instance);
+    }
+    for(Mesh_Instance const& instance: instances) {
+        models[next_instance[instance.batch]] = instance.model;
+        next_instance[instance.batch] += 1;
+    }
+
+    glVertexArrayVertexBuffer(mesh_vao, 0, vertex_allocation.buffer, vertex_allocation.offset, sizeof(Vertex));
+    glVertexArrayVertexBuffer(mesh_vao, 1, instance_allocation.buffer, instance_allocation.offset, sizeof(Mat4));
+    glBindVertexArray(mesh_vao);
+    for(i64 const index: order) {
+        Mesh_Batch const& batch = batches[index];
+        bind_shader(batch.shader);
+        glDrawArraysInstancedBaseInstance(GL_TRIANGLES, batch.first_vertex, batch.vertex_count, batch.instance_count, batch.first_instance);
+    }
+    glBindVertexArray(vao);
+
+    TRACE_COUNTER("mesh_batches", batches.size());
+    return vertex_count * sizeof(Vertex) + instance_count * sizeof(Mat4);
+}
+
+void render(World& world, Mat4 const& view, Mat4 const& proj, Vec2 const viewport_size) {
+    TRACE_ZONE("render");
+    frame_arena.reset();
+    i64 bytes_uploaded = 0;
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    Vertex* const vertex_buffer_begin = (Vertex*)vbo.mapped;
-    Vertex* vertex_buffer = (Vertex*)vbo.mapped;
+    if(viewport_size.x < 1.0f || viewport_size.y < 1.0f) {
+        return;
+    }
+
+    // Waits for the gpu to finish the frame that used the same upload region.
+    begin_upload_frame(*upload_ring);
+
     Mat4 const vp = proj * view;
+    Isolines* isolines = nullptr;
+    {
+        Slice<Isolines> const components = world.components<Isolines>();
+        ANTON_FAIL(components.size() <= 1, "too many isolines");
+        if(components.size() == 1 && components[0].enabled) {
+            isolines = &components[0];
+        }
+    }
+
+    // The constants are written once and shared by every draw of the frame.
+    {
+        Frame_Constants constants;
+        constants.vp = vp;
+        if(isolines) {
+            bytes_uploaded += upload_point_mass_objects(world, constants.max_field);
+            constants.render_mode = (i32)isolines->mode;
+            constants.softening_length = isolines->softening_length;
+            constants.softening = (i32)isolines->softening;
+        }
+
+        Upload_Allocation const allocation = allocate_upload(*upload_ring, sizeof(Frame_Constants), uniform_buffer_alignment);
+        *(Frame_Constants*)allocation.mapped = constants;
+        bytes_uploaded += sizeof(Frame_Constants);
+        glBindBufferRange(GL_UNIFORM_BUFFER, 0, allocation.buffer, allocation.offset, sizeof(Frame_Constants));
+    }
+
+    // Drawn first so that the bodies cover the tracers and the trails.
+    if(world.has_type<Tracer_Cloud>()) {
+        bytes_uploaded += render_tracers(world);
+    }
+
+    if(world.has_type<Orbit_Trails>()) {
+        Slice<Orbit_Trails> const trails = world.components<Orbit_Trails>();
+        ANTON_FAIL(trails.size() <= 1, "too many orbit trails");
+        if(trails.size() == 1 && trails[0].enabled) {
+            bytes_uploaded += render_trails(trails[0]);
+        }
+    }
+
+    // The projection is orthographic, hence the visible part of the xy plane is a rectangle.
+    Mat4 const inverse_vp = math::inverse(vp);
+    Vec4 const corner_a = inverse_vp * Vec4{-1.0f, -1.0f, 0.0f, 1.0f};
+    Vec4 const corner_b = inverse_vp * Vec4{1.0f, 1.0f, 0.0f, 1.0f};
+    Vec2 const view_min{math::min(corner_a.x, corner_b.x), math::min(corner_a.y, corner_b.y)};
+    Vec2 const view_max{math::max(corner_a.x, corner_b.x), math::max(corner_a.y, corner_b.y)};
+    f32 const pixels_per_unit = viewport_size.x / (view_max.x - view_min.x);
+
+    // The bodies are collected first and drawn afterwards grouped by their state.
+    Polymorphic_Allocator const allocator{&frame_arena};
+    Arena_Array<Mesh_Batch> batches{allocator};
+    Arena_Array<Mesh_Instance> instances{allocator};
+    Arena_Array<Vertex> sprites{allocator};
+    i64 const grid_width = ((i64)viewport_size.x + cluster_cell_size - 1) / cluster_cell_size;
+    i64 const grid_height = ((i64)viewport_size.y + cluster_cell_size - 1) / cluster_cell_size;
+    Arena_Array<Cluster_Cell> cells{allocator};
+    cells.resize(grid_width * grid_height);
+    Arena_Array<i64> occupied_cells{allocator};
+
+    i64 culled_count = 0;
+    i64 full_detail_count = 0;
+    i64 low_detail_count = 0;
+    // Batch of the latest mesh. Consecutive bodies usually share it.
+    i64 batch = -1;
     for(Entity const entity: world.entities<Mesh_Renderer>()) {
         Mesh_Renderer& mesh_renderer = world.get_component<Mesh_Renderer>(entity);
         Transform& transform = world.get_component<Transform>(entity);
-        Mat4 const model = math::translate(transform.postion) * math::rotate(transform.orientation) * math::scale(transform.scale);
-        Mat4 const mvp = vp * model;
-        bind_shader(mesh_renderer.shader);
-        set_uniform_mat4(mesh_renderer.shader, String{"mvp"}, mvp);
         Mesh& mesh = get_mesh(mesh_renderer.mesh);
-        copy(mesh.vertices.begin(), mesh.vertices.end(), vertex_buffer);
-        glDrawArrays(GL_TRIANGLES, vertex_buffer - vertex_buffer_begin, mesh.vertices.size());
-        vertex_buffer += mesh.vertices.size();
-    }
-
-    Slice<Entity> isolines = world.entities<Isolines>();
-    ANTON_FAIL(isolines.size() <= 1, "too many isolines");
-    if(isolines.size() == 1) {
-        Entity const entity = isolines[0];
-        Isolines& isolines = world.get_component<Isolines>(entity);
-        if(isolines.enabled) {
-            constexpr f32 gravitational_constant = 6.67408e-11f;
-            Slice<Point_Mass> point_masses = world.components<Point_Mass>();
-            Point_Mass_Object* point_mass_objects = (Point_Mass_Object*)point_mass_objects_buffer.mapped;
-            f32 max_field_value = 0.0f;
-            for(Point_Mass const& v: point_masses) {
-                point_mass_objects->position = v.position;
-                point_mass_objects->mass = v.mass;
-                point_mass_objects += 1;
-                // at distance 1.0 from the mass
-                max_field_value = math::max(max_field_value, gravitational_constant * v.mass);
+        f32 const radius = mesh.bounding_radius * math::max(math::abs(transform.scale.x), math::abs(transform.scale.y));
+        Vec2 const position{transform.postion.x, transform.postion.y};
+        if(position.x + radius < view_min.x || position.x - radius > view_max.x || position.y + radius < view_min.y || position.y - radius > view_max.y) {
+            culled_count += 1;
+            continue;
+        }
+
+        f32 const screen_radius = radius * pixels_per_unit;
+        Handle<Mesh> lod_mesh;
+        if(screen_radius >= full_detail_radius) {
+            lod_mesh = mesh_renderer.mesh;
+        } else if(screen_radius >= low_detail_radius) {
+            lod_mesh = mesh_renderer.low_detail_mesh ? mesh_renderer.low_detail_mesh : mesh_renderer.mesh;
+        }
+
+        if(lod_mesh) {
+            if(lod_mesh == mesh_renderer.mesh) {
+                full_detail_count += 1;
+            } else {
+                low_detail_count += 1;
             }
 
-            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, point_mass_objects_buffer.handle, 0, point_masses.size() * sizeof(Point_Mass_Object));
+            if(batch == -1 || batches[batch].shader != mesh_renderer.shader || batches[batch].mesh != lod_mesh) {
+                batch = 0;
+                while(batch < batches.size() && (batches[batch].shader != mesh_renderer.shader || batches[batch].mesh != lod_mesh)) {
+                    batch += 1;
+                }
 
-            Mesh& mesh = get_mesh(isolines.mesh);
-            copy(mesh.vertices.begin(), mesh.vertices.end(), vertex_buffer);
-            bind_shader(isolines.shader);
-            set_uniform_mat4(isolines.shader, String{"vp"}, vp);
-            set_uniform_f32(isolines.shader, String{"max_field"}, max_field_value);
-            set_uniform_i32(isolines.shader, String{"render_mode"}, (i32)isolines.mode);
-            glDrawArrays(GL_TRIANGLES, vertex_buffer - vertex_buffer_begin, mesh.vertices.size());
-            vertex_buffer += mesh.vertices.size();
+                if(batch == batches.size()) {
+                    i64 const vertex_count = lod_mesh == mesh_renderer.mesh ? mesh.vertices.size() : get_mesh(lod_mesh).vertices.size();
+                    batches.emplace_back(Mesh_Batch{mesh_renderer.shader, lod_mesh, vertex_count, 0, 0, 0});
+                }
+            }
+
+            Mat4 const model = math::translate(transform.postion) * math::rotate(transform.orientation) * math::scale(transform.scale);
+            batches[batch].instance_count += 1;
+            instances.emplace_back(Mesh_Instance{batch, model});
+            continue;
+        }
+
+        Vec4 const color = mesh.vertices.size() > 0 ? mesh.vertices[0].color : Vec4{1.0f};
+        if(screen_radius >= point_radius) {
+            sprites.emplace_back(Vertex{transform.postion, color});
+            continue;
         }
+
+        // Sub-pixel bodies are merged into clusters.
+        Vec2 const offset = position - view_min;
+        i64 const cell_x = math::min((i64)(math::max(offset.x, 0.0f) * pixels_per_unit) / cluster_cell_size, grid_width - 1);
+        i64 const cell_y = math::min((i64)(math::max(offset.y, 0.0f) * pixels_per_unit) / cluster_cell_size, grid_height - 1);
+        i64 const cell_index = cell_y * grid_width + cell_x;
+        Cluster_Cell& cell = cells[cell_index];
+        if(cell.count == 0) {
+            occupied_cells.emplace_back(cell_index);
+            cell.color = color;
+        }
+        cell.offset_sum += offset;
+        cell.count += 1;
     }
+
+    if(instances.size() > 0) {
+        bytes_uploaded += draw_mesh_batches(Slice<Mesh_Batch>{batches.begin(), batches.end()}, Slice<Mesh_Instance const>{instances.begin(), instances.end()});
+    }
+
+    i64 const point_count = sprites.size() + occupied_cells.size();
+    if(point_shader && point_count > 0) {
+        TRACE_ZONE("upload_points");
+        Upload_Allocation const allocation = allocate_upload(*upload_ring, point_count * sizeof(Vertex), 16);
+        Vertex* const vertices = (Vertex*)allocation.mapped;
+        copy(sprites.begin(), sprites.end(), vertices);
+        for(i64 i = 0; i < occupied_cells.size(); ++i) {
+            Cluster_Cell const& cell = cells[occupied_cells[i]];
+            Vec2 const position = view_min + cell.offset_sum / (f32)cell.count;
+            f32 const alpha = math::min((f32)cell.count / (f32)cluster_saturation_count, 1.0f);
+            vertices[sprites.size() + i] = Vertex{Vec3{position, 0.0f}, Vec4{cell.color.x, cell.color.y, cell.color.z, alpha}};
+        }
+        bytes_uploaded += point_count * sizeof(Vertex);
+
+        glVertexArrayVertexBuffer(vao, 0, allocation.buffer, allocation.offset, sizeof(Vertex));
+        glEnable(GL_BLEND);
+        bind_shader(point_shader);
+        set_uniform_f32(point_shader, "point_size", sprite_size);
+        glDrawArrays(GL_POINTS, 0, sprites.size());
+        set_uniform_f32(point_shader, "point_size", (f32)cluster_cell_size);
+        glDrawArrays(GL_POINTS, sprites.size(), occupied_cells.size());
+        glDisable(GL_BLEND);
+    }
+
+    TRACE_COUNTER("culled_bodies", culled_count);
+    TRACE_COUNTER("full_detail_bodies", full_detail_count);
+    TRACE_COUNTER("low_detail_bodies", low_detail_count);
+    TRACE_COUNTER("sprite_bodies", sprites.size());
+    TRACE_COUNTER("clusters", occupied_cells.size());
+
+    if(isolines) {
+        TRACE_ZONE("isolines");
+        // The point mass objects and the constants have been bound at the beginning of the frame.
+        Mesh& mesh = get_mesh(isolines->mesh);
+        Upload_Allocation const mesh_allocation = allocate_upload(*upload_ring, mesh.vertices.size() * sizeof(Vertex), 16);
+        copy(mesh.vertices.begin(), mesh.vertices.end(), (Vertex*)mesh_allocation.mapped);
+        bytes_uploaded += mesh.vertices.size() * sizeof(Vertex);
+        glVertexArrayVertexBuffer(vao, 0, mesh_allocation.buffer, mesh_allocation.offset, sizeof(Vertex));
+        bind_shader(isolines->shader);
+        glDrawArrays(GL_TRIANGLES, 0, mesh.vertices.size());
+    }
+
+    end_upload_frame(*upload_ring);
+
+    TRACE_COUNTER("bytes_uploaded", bytes_uploaded);
+}
+
+Memory_Allocator& get_frame_allocator() {
+    return frame_arena;
+}
+
+i64 get_frame_arena_high_water_mark() {
+    return frame_arena.get_high_water_mark();
 }
@@ -1,9 +1,39 @@
 #pragma once
 
+#include <anton/allocator.hpp>
 #include <anton/math/mat4.hpp>
+#include <anton/math/vec2.hpp>
 #include <build.hpp>
+#include <shader.hpp>
 #include <world.hpp>
 
 void init_rendering();
 
-void render(World& world, Mat4 const& view, Mat4 const& proj);
+// set_point_shader
+// Shader used to draw the bodies that are too small to be drawn as meshes.
+// Must declare the Frame uniform block and take the point_size uniform.
+//
+void set_point_shader(Handle<Shader> const& shader);
+
+// render
+// Draws the Mesh_Renderers that intersect the view with a level of detail chosen by their size on the screen:
+// the mesh, the low detail mesh, a point or, below a pixel, a point per cluster of bodies.
+// The meshes are drawn instanced, a call per shader and mesh. The vp matrix and the isolines settings
+// are provided to all shaders in the Frame uniform block at binding 0.
+// The Tracer_Clouds and the Orbit_Trails, if their types are registered, are drawn underneath the bodies.
+//
+// Parameters:
+// viewport_size - size of the viewport in pixels.
+//
+void render(World& world, Mat4 const& view, Mat4 const& proj, Vec2 viewport_size);
+
+// get_frame_allocator
+// Allocator for memory that lives until the end of the current frame.
+// All allocations are released at the beginning of the next render.
+//
+[[nodiscard]] Memory_Allocator& get_frame_allocator();
+
+// get_frame_arena_high_water_mark
+// Largest number of bytes of scratch memory used by a single frame.
+//
+[[nodiscard]] i64 get_frame_arena_high_water_mark();
@@ -0,0 +1,72 @@
+#include <scene.hpp>
+
+#include <anton/array.hpp>
+#include <file.hpp>
+#include <point_mass.hpp>
+#include <transform.hpp>
+
+Array<Point_Mass> load_point_masses_from_file(String const& path) {
+    String contents = read_file(path);
+
+    auto parse_csv_file = [](String const& contents) -> Array<Point_Mass> {
+        auto find_line_end = [](auto begin, auto end) {
+            for(; begin != end && *begin != '\n'; ++begin) {}
+            return begin;
+        };
+
+        auto read_float = [](auto& begin, auto end) {
+            i64 pos = find_substring(String_View{begin, end}, ",");
+            auto first = begin;
+            // Skip spaces
+            while(*first == ' ') {
+                ++first;
+            }
+
+            auto last = begin;
+            if(pos != npos) {
+                last += pos;
+            } else {
+                last = end;
+            }
+
+            begin = last;
+            if(begin != end) {
+                ++begin;
+            }
+
+            return str_to_f32(String{first, last});
+        };
+
+        Array<Point_Mass> point_masses;
+        auto begin = contents.bytes_begin();
+        auto end = contents.bytes_end();
+        while(begin != end) {
+            auto line_end = find_line_end(begin, end);
+            f32 const pos_x = read_float(begin, line_end);
+            f32 const pos_y = read_float(begin, line_end);
+            f32 const vel_x = read_float(begin, line_end);
+            f32 const vel_y = read_float(begin, line_end);
+            f32 const mass = read_float(begin, line_end);
+            point_masses.emplace_back(Point_Mass{Vec2{pos_x, pos_y}, Vec2{vel_x, vel_y}, mass});
+
+            begin = line_end;
+            // begin points either to '\n' or end.
+            // move to the next line if not equal to end
+            if(begin != end) {
+                ++begin;
+            }
+        }
+
+        return point_masses;
+    };
+
+    return parse_csv_file(contents);
+}
+
+void load_scene_from_file(World& world, String const& path) {
+    for(Point_Mass const& point_mass: load_point_masses_from_file(path)) {
+        Entity e = world.create();
+        world.add_component(e, point_mass);
+        world.add_component(e, Transform{});
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <anton/array.hpp>
+#include <anton/string.hpp>
+#include <build.hpp>
+#include <point_mass.hpp>
+#include <world.hpp>
+
+// load_point_masses_from_file
+// Loads point masses from a csv file with lines in the format
+// position x, position y, velocity x, velocity y, mass
+//
+[[nodiscard]] Array<Point_Mass> load_point_masses_from_file(String const& path);
+
+// load_scene_from_file
+// Loads point masses from a csv file with load_point_masses_from_file.
+// Every point mass is added as a new entity with Point_Mass and Transform components.
+//
+void load_scene_from_file(World& world, String const& path);
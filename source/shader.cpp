@@ -13,15 +13,23 @@ struct Shader_Stage_Resource {
     u32 gl_handle = 0;
 };
 
+struct Shader_Uniform {
+    String name;
+    i32 location;
+};
+
 struct Shader_Resource {
     Handle<Shader> handle;
     u32 gl_handle;
+    Array<Shader_Uniform> uniforms;
 };
 
 static Array<Shader_Stage_Resource> shader_stage_resources;
 static u64 shader_stage_handle_index_counter = 0;
 static Array<Shader_Resource> shader_resources;
 static u64 shader_handle_index_counter = 0;
+// Program bound by the latest bind_shader.
+static u32 bound_program = 0;
 
 Handle<Shader_Stage> compile_shader_source(String_View name, Shader_Stage_Type type, String_View source) {
     u32 gl_handle = 0;
@@ -94,44 +102,78 @@ Handle<Shader> create_shader(String_View name, Handle<Shader_Stage> const& verte
         ANTON_FAIL(false, log.data());
     }
 
+    // Querying the locations from the driver on every use is slow, hence they are cached.
+    // Members of the uniform blocks have no locations and are skipped.
+    Array<Shader_Uniform> uniforms;
+    {
+        GLint uniform_count = 0;
+        glGetProgramiv(gl_handle, GL_ACTIVE_UNIFORMS, &uniform_count);
+        GLint max_name_length = 0;
+        glGetProgramiv(gl_handle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+        Array<char> name_buffer;
+        name_buffer.resize(math::max(max_name_length, 1));
+        for(i32 i = 0; i < uniform_count; ++i) {
+            GLsizei name_length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(gl_handle, i, name_buffer.size(), &name_length, &size, &type, name_buffer.data());
+            i32 const location = glGetUniformLocation(gl_handle, name_buffer.data());
+            if(location != -1) {
+                uniforms.emplace_back(String{name_buffer.data(), name_length}, location);
+            }
+        }
+    }
+
     Handle<Shader> handle{shader_handle_index_counter++};
-    shader_resources.emplace_back(handle, gl_handle);
+    shader_resources.emplace_back(handle, gl_handle, ANTON_MOV(uniforms));
     return handle;
 }
 
-void bind_shader(Handle<Shader> const& handle) {
+static Shader_Resource& get_shader_resource(Handle<Shader> const& handle) {
     ANTON_FAIL(handle, "invalid handle");
     auto r = find_if(shader_resources.begin(), shader_resources.end(), [&handle](Shader_Resource const& resource) { return resource.handle == handle; });
     ANTON_FAIL(r != shader_resources.end(), "handle to non-existent resource");
-    glUseProgram(r->gl_handle);
+    return *r;
 }
 
-void set_uniform_i32(Handle<Shader> const& handle, String const& name, i32 v) {
-    ANTON_FAIL(handle, "invalid handle");
-    auto r = find_if(shader_resources.begin(), shader_resources.end(), [&handle](Shader_Resource const& resource) { return resource.handle == handle; });
-    ANTON_FAIL(r != shader_resources.end(), "handle to non-existent resource");
-    i32 const location = glGetUniformLocation(r->gl_handle, name.data());
+// Returns the location of the uniform or -1 if the shader does not have it.
+static i32 find_uniform_location(Shader_Resource const& resource, String_View const name) {
+    for(Shader_Uniform const& uniform: resource.uniforms) {
+        if(uniform.name == name) {
+            return uniform.location;
+        }
+    }
+    return -1;
+}
+
+void bind_shader(Handle<Shader> const& handle) {
+    Shader_Resource const& resource = get_shader_resource(handle);
+    if(resource.gl_handle != bound_program) {
+        glUseProgram(resource.gl_handle);
+        bound_program = resource.gl_handle;
+    }
+}
+
+void set_uniform_i32(Handle<Shader> const& handle, String_View const name, i32 v) {
+    Shader_Resource const& resource = get_shader_resource(handle);
+    i32 const location = find_uniform_location(resource, name);
     if(location != -1) {
-        glProgramUniform1i(r->gl_handle, location, v);
+        glProgramUniform1i(resource.gl_handle, location, v);
     }
 }
 
-void set_uniform_f32(Handle<Shader> const& handle, String const& name, f32 v) {
-    ANTON_FAIL(handle, "invalid handle");
-    auto r = find_if(shader_resources.begin(), shader_resources.end(), [&handle](Shader_Resource const& resource) { return resource.handle == handle; });
-    ANTON_FAIL(r != shader_resources.end(), "handle to non-existent resource");
-    i32 const location = glGetUniformLocation(r->gl_handle, name.data());
+void set_uniform_f32(Handle<Shader> const& handle, String_View const name, f32 v) {
+    Shader_Resource const& resource = get_shader_resource(handle);
+    i32 const location = find_uniform_location(resource, name);
     if(location != -1) {
-        glProgramUniform1f(r->gl_handle, location, v);
+        glProgramUniform1f(resource.gl_handle, location, v);
     }
 }
 
-void set_uniform_mat4(Handle<Shader> const& handle, String const& name, Mat4 const& v) {
-    ANTON_FAIL(handle, "invalid handle");
-    auto r = find_if(shader_resources.begin(), shader_resources.end(), [&handle](Shader_Resource const& resource) { return resource.handle == handle; });
-    ANTON_FAIL(r != shader_resources.end(), "handle to non-existent resource");
-    i32 const location = glGetUniformLocation(r->gl_handle, name.data());
+void set_uniform_mat4(Handle<Shader> const& handle, String_View const name, Mat4 const& v) {
+    Shader_Resource const& resource = get_shader_resource(handle);
+    i32 const location = find_uniform_location(resource, name);
     if(location != -1) {
-        glProgramUniformMatrix4fv(r->gl_handle, location, 1, GL_FALSE, v.data());
+        glProgramUniformMatrix4fv(resource.gl_handle, location, 1, GL_FALSE, v.data());
     }
-}
\ No newline at end of file
+}
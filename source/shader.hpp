@@ -17,9 +17,14 @@ Handle<Shader> create_shader(String_View name, Handle<Shader_Stage> const& verte
 
 // bind_shader
 // Binds shader for use during the following draw operations.
+// Does nothing if shader is already bound.
 //
 void bind_shader(Handle<Shader> const& handle);
 
-void set_uniform_i32(Handle<Shader> const& handle, String const& name, i32 v);
-void set_uniform_f32(Handle<Shader> const& handle, String const& name, f32 v);
-void set_uniform_mat4(Handle<Shader> const& handle, String const& name, Mat4 const& v);
+// set_uniform_i32, set_uniform_f32, set_uniform_mat4
+// Set the value of a uniform of the default block. The locations are looked up once
+// when the shader is created. Uniforms that do not exist in the shader are ignored.
+//
+void set_uniform_i32(Handle<Shader> const& handle, String_View name, i32 v);
+void set_uniform_f32(Handle<Shader> const& handle, String_View name, f32 v);
+void set_uniform_mat4(Handle<Shader> const& handle, String_View name, Mat4 const& v);
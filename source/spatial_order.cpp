@@ -0,0 +1,174 @@
+#include <spatial_order.hpp>
+
+#include <point_mass.hpp>
+#include <threads.hpp>
+#include <trace.hpp>
+#include <world.hpp>
+
+constexpr u32 curve_resolution = 65536;
+// Number of keys histogrammed and scattered by a single task.
+constexpr i64 sort_block_size = 16384;
+constexpr i64 radix_size = 256;
+
+bool parse_space_filling_curve(String_View const name, Space_Filling_Curve& curve) {
+    if(name == u8"morton") {
+        curve = Space_Filling_Curve::morton;
+        return true;
+    } else if(name == u8"hilbert") {
+        curve = Space_Filling_Curve::hilbert;
+        return true;
+    } else {
+        return false;
+    }
+}
+
+// Inserts a zero bit above every bit of the low 16 bits.
+static u32 spread_bits(u32 v) {
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+static u32 compute_morton_key(u32 const x, u32 const y) {
+    return spread_bits(x) | (spread_bits(y) << 1);
+}
+
+// Distance along the Hilbert curve of the cell (x, y). Descends the quadrants from the
+// largest, rotating the coordinates so that every quadrant is traversed in the canonical orientation.
+static u32 compute_hilbert_key(u32 x, u32 y) {
+    u32 key = 0;
+    for(u32 s = curve_resolution / 2; s > 0; s /= 2) {
+        u32 const rx = (x & s) != 0;
+        u32 const ry = (y & s) != 0;
+        key += s * s * ((3 * rx) ^ ry);
+        if(ry == 0) {
+            if(rx == 1) {
+                x = curve_resolution - 1 - x;
+                y = curve_resolution - 1 - y;
+            }
+            u32 const t = x;
+            x = y;
+            y = t;
+        }
+    }
+    return key;
+}
+
+// Maps nan and values below the range to 0.
+static u32 quantize(f32 const value, f32 const min, f32 const scale) {
+    f32 const cell = (value - min) * scale;
+    return cell > 0.0f ? (u32)math::min(cell, (f32)(curve_resolution - 1)) : 0;
+}
+
+// Stable least significant digit radix sort of the entries by their upper 32 bits.
+// The digits are histogrammed and scattered by blocks in parallel. The blocks write
+// to disjoint ranges given by the prefix sum over the digits and the blocks.
+// Returns the buffer that holds the result.
+static u64* radix_sort(u64* entries, u64* scratch, i64 const count, i32 const thread_count) {
+    i64 const block_count = (count + sort_block_size - 1) / sort_block_size;
+    Array<i64> offsets;
+    offsets.resize(block_count * radix_size);
+    for(i64 shift = 32; shift < 64; shift += 8) {
+        TRACE_ZONE("radix_sort_pass");
+        parallel_for(count, sort_block_size, thread_count, [entries, &offsets, shift](i64 const begin, i64 const end) {
+            i64* const histogram = offsets.data() + begin / sort_block_size * radix_size;
+            for(i64 digit = 0; digit < radix_size; ++digit) {
+                histogram[digit] = 0;
+            }
+            for(i64 i = begin; i < end; ++i) {
+                histogram[(entries[i] >> shift) & (radix_size - 1)] += 1;
+            }
+        });
+
+        bool skip = false;
+        i64 offset = 0;
+        for(i64 digit = 0; digit < radix_size; ++digit) {
+            i64 const digit_begin = offset;
+            for(i64 block = 0; block < block_count; ++block) {
+                i64 const digit_count = offsets[block * radix_size + digit];
+                offsets[block * radix_size + digit] = offset;
+                offset += digit_count;
+            }
+            // Every entry has the same digit. The pass would not move anything.
+            skip = skip || offset - digit_begin == count;
+        }
+
+        if(skip) {
+            continue;
+        }
+
+        parallel_for(count, sort_block_size, thread_count, [entries, scratch, &offsets, shift](i64 const begin, i64 const end) {
+            i64* const block_offsets = offsets.data() + begin / sort_block_size * radix_size;
+            for(i64 i = begin; i < end; ++i) {
+                u64 const entry = entries[i];
+                i64& offset = block_offsets[(entry >> shift) & (radix_size - 1)];
+                scratch[offset] = entry;
+                offset += 1;
+            }
+        });
+
+        u64* const sorted = scratch;
+        scratch = entries;
+        entries = sorted;
+    }
+    return entries;
+}
+
+void compute_spatial_order(Slice<Point_Mass const> const point_masses, Space_Filling_Curve const curve, i32 const thread_count, Slice<i64> const order) {
+    TRACE_ZONE("compute_spatial_order");
+    i64 const count = point_masses.size();
+    ANTON_FAIL(count <= (i64)0xFFFFFFFF, "too many point masses to order");
+    if(count == 0) {
+        return;
+    }
+
+    Vec2 min = point_masses[0].position;
+    Vec2 max = point_masses[0].position;
+    for(Point_Mass const& point_mass: point_masses) {
+        Vec2 const position = point_mass.position;
+        min.x = position.x < min.x ? position.x : min.x;
+        min.y = position.y < min.y ? position.y : min.y;
+        max.x = position.x > max.x ? position.x : max.x;
+        max.y = position.y > max.y ? position.y : max.y;
+    }
+
+    // Cells are square so that the curve is equally local along both axes.
+    f32 const extent = math::max(max.x - min.x, max.y - min.y);
+    f32 const scale = extent > 0.0f ? (f32)curve_resolution / extent : 0.0f;
+
+    // The key in the upper and the index in the lower 32 bits.
+    Array<u64> entries;
+    entries.resize(count);
+    Array<u64> scratch;
+    scratch.resize(count);
+    parallel_for(count, sort_block_size, thread_count, [point_masses, curve, min, scale, &entries](i64 const begin, i64 const end) {
+        for(i64 i = begin; i < end; ++i) {
+            Vec2 const position = point_masses[i].position;
+            u32 const x = quantize(position.x, min.x, scale);
+            u32 const y = quantize(position.y, min.y, scale);
+            u32 const key = curve == Space_Filling_Curve::hilbert ? compute_hilbert_key(x, y) : compute_morton_key(x, y);
+            entries[i] = ((u64)key << 32) | (u64)i;
+        }
+    });
+
+    u64 const* const sorted = radix_sort(entries.data(), scratch.data(), count, thread_count);
+    for(i64 i = 0; i < count; ++i) {
+        order[i] = (i64)(sorted[i] & 0xFFFFFFFF);
+    }
+}
+
+void reorder_bodies(World& world, Space_Filling_Curve const curve, i32 const thread_count, Array<i64>& order) {
+    TRACE_ZONE("reorder_bodies");
+    Slice<Point_Mass> const point_masses = world.components<Point_Mass>();
+    order.resize(point_masses.size());
+    compute_spatial_order(Slice<Point_Mass const>{point_masses.begin(), point_masses.end()}, curve, thread_count, order);
+
+    Slice<Entity> const entities = world.entities<Point_Mass>();
+    Array<Entity> entity_order{reserve, entities.size()};
+    for(i64 const index: order) {
+        entity_order.emplace_back(entities[index]);
+    }
+    world.reorder_entities(entity_order);
+}
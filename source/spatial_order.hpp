@@ -0,0 +1,40 @@
+#pragma once
+
+#include <anton/array.hpp>
+#include <anton/slice.hpp>
+#include <anton/string_view.hpp>
+#include <build.hpp>
+
+struct Point_Mass;
+struct World;
+
+enum struct Space_Filling_Curve {
+    morton,
+    // Consecutive cells are always adjacent, hence neighbours in storage are closer than with morton.
+    hilbert,
+};
+
+// parse_space_filling_curve
+//
+// Returns:
+// true if name is one of morton or hilbert.
+//
+[[nodiscard]] bool parse_space_filling_curve(String_View name, Space_Filling_Curve& curve);
+
+// compute_spatial_order
+// Sorts the point masses along the curve through the square that bounds them.
+// The curve has 2^16 cells along each axis. Point masses in the same cell keep their order.
+//
+// Parameters:
+// order - point_masses.size() elements. order[i] is the index of the point mass that comes i-th.
+//
+void compute_spatial_order(Slice<Point_Mass const> point_masses, Space_Filling_Curve curve, i32 thread_count, Slice<i64> order);
+
+// reorder_bodies
+// Sorts the storage of the entities with a Point_Mass along the curve. All components of
+// those entities are moved consistently, hence the entity handles remain valid.
+//
+// Parameters:
+// order - receives the order computed by compute_spatial_order, for the data indexed by point mass.
+//
+void reorder_bodies(World& world, Space_Filling_Curve curve, i32 thread_count, Array<i64>& order);
@@ -0,0 +1,128 @@
+#include <threads.hpp>
+
+#include <allocation_tracking.hpp>
+#include <anton/array.hpp>
+#include <anton/assert.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct Thread_Pool {
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable work_done;
+    // The threads are never joined. They live until the process exits.
+    Array<std::thread*> workers;
+    u64 generation = 0;
+
+    // Serializes callers of parallel_for coming from different threads.
+    std::mutex job_mutex;
+    Parallel_For_Function function = nullptr;
+    void* user_data = nullptr;
+    i64 count = 0;
+    i64 chunk_size = 0;
+    i64 chunk_count = 0;
+    i32 max_workers = 0;
+    // The workers count their allocations under the tag of the caller.
+    Allocation_Tag allocation_tag = Allocation_Tag::other;
+    // Workers that have to acknowledge the current job before it may complete.
+    i32 pending_workers = 0;
+    std::atomic<i64> next_chunk = 0;
+};
+
+static thread_local bool inside_job = false;
+
+// Never destroyed so that the workers never observe a dead pool during static destruction.
+static Thread_Pool& get_thread_pool() {
+    static Thread_Pool* const pool = new Thread_Pool;
+    return *pool;
+}
+
+static void run_chunks(Thread_Pool& pool) {
+    inside_job = true;
+    while(true) {
+        i64 const chunk = pool.next_chunk.fetch_add(1, std::memory_order_relaxed);
+        if(chunk >= pool.chunk_count) {
+            break;
+        }
+
+        i64 const begin = chunk * pool.chunk_size;
+        i64 const end = math::min(begin + pool.chunk_size, pool.count);
+        pool.function(begin, end, pool.user_data);
+    }
+    inside_job = false;
+}
+
+static void worker_main(Thread_Pool& pool, i32 const index) {
+    u64 seen_generation = 0;
+    std::unique_lock<std::mutex> lock{pool.mutex};
+    while(true) {
+        pool.work_available.wait(lock, [&pool, seen_generation] { return pool.generation != seen_generation; });
+        seen_generation = pool.generation;
+        if(index >= pool.max_workers) {
+            continue;
+        }
+
+        lock.unlock();
+        {
+            ALLOCATION_SCOPE(pool.allocation_tag);
+            run_chunks(pool);
+        }
+        lock.lock();
+        pool.pending_workers -= 1;
+        if(pool.pending_workers == 0) {
+            pool.work_done.notify_all();
+        }
+    }
+}
+
+i32 get_hardware_thread_count() {
+    i32 const count = std::thread::hardware_concurrency();
+    return math::max(count, 1);
+}
+
+void parallel_for(i64 const count, i64 const chunk_size, i32 const thread_count, Parallel_For_Function const function, void* const user_data) {
+    ANTON_FAIL(chunk_size > 0, "chunk_size must be greater than 0");
+    if(count <= 0) {
+        return;
+    }
+
+    i64 const chunk_count = (count + chunk_size - 1) / chunk_size;
+    if(inside_job || thread_count <= 1 || chunk_count == 1) {
+        for(i64 begin = 0; begin < count; begin += chunk_size) {
+            function(begin, math::min(begin + chunk_size, count), user_data);
+        }
+        return;
+    }
+
+    Thread_Pool& pool = get_thread_pool();
+    std::lock_guard<std::mutex> job_lock{pool.job_mutex};
+    {
+        std::lock_guard<std::mutex> lock{pool.mutex};
+        // The calling thread participates in the job.
+        i32 const max_workers = (i32)math::min((i64)thread_count - 1, chunk_count - 1);
+        while(pool.workers.size() < max_workers) {
+            i32 const index = pool.workers.size();
+            pool.workers.emplace_back(new std::thread(worker_main, std::ref(pool), index));
+        }
+
+        pool.function = function;
+        pool.user_data = user_data;
+        pool.count = count;
+        pool.chunk_size = chunk_size;
+        pool.chunk_count = chunk_count;
+        pool.max_workers = max_workers;
+        pool.allocation_tag = get_allocation_tag();
+        pool.pending_workers = max_workers;
+        pool.next_chunk.store(0, std::memory_order_relaxed);
+        pool.generation += 1;
+    }
+    pool.work_available.notify_all();
+
+    run_chunks(pool);
+
+    std::unique_lock<std::mutex> lock{pool.mutex};
+    pool.work_done.wait(lock, [&pool] { return pool.pending_workers == 0; });
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <build.hpp>
+
+[[nodiscard]] i32 get_hardware_thread_count();
+
+using Parallel_For_Function = void (*)(i64 begin, i64 end, void* user_data);
+
+// parallel_for
+// Splits [0, count) into chunks of chunk_size elements and processes them on the shared
+// worker pool. Returns once every chunk has been processed.
+// The chunks depend only on count and chunk_size, never on the number of threads.
+// Calls from within a running chunk execute serially on the calling thread.
+//
+// Parameters:
+// thread_count - maximum number of threads to use including the calling thread.
+//
+void parallel_for(i64 count, i64 chunk_size, i32 thread_count, Parallel_For_Function function, void* user_data);
+
+template<typename Function>
+void parallel_for(i64 const count, i64 const chunk_size, i32 const thread_count, Function const& function) {
+    Parallel_For_Function const invoke = [](i64 const begin, i64 const end, void* const user_data) { (*(Function const*)user_data)(begin, end); };
+    parallel_for(count, chunk_size, thread_count, invoke, (void*)&function);
+}
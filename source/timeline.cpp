@@ -0,0 +1,379 @@
+#include <timeline.hpp>
+
+#include <anton/array.hpp>
+#include <anton/assert.hpp>
+#include <point_mass.hpp>
+#include <trace.hpp>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct Stored_State {
+    i64 step;
+    // Positions and velocities interleaved. The masses never change and are stored once.
+    Array<Vec2> state;
+    // Value of the use counter when the state was last used. Only used by the cache.
+    u64 last_use;
+};
+
+// Settings of the physics used from step on.
+struct Settings_Change {
+    i64 step;
+    Physics_Settings settings;
+};
+
+struct Timeline {
+    Timeline_Settings settings;
+    // Sorted by step. The first change is always step 0.
+    Array<Settings_Change> settings_changes;
+    Array<f32> masses;
+
+    mutable std::mutex mutex;
+    std::condition_variable request_available;
+    std::thread worker;
+    bool quit = false;
+
+    // Sorted by step. The first keyframe is always step 0.
+    Array<Stored_State> keyframes;
+    i64 keyframe_interval = 0;
+    i64 end = 0;
+
+    Array<Stored_State> cache;
+    i64 cache_bytes = 0;
+    u64 use_counter = 0;
+
+    // Every request and cancellation increments the generation which
+    // invalidates the work of the background thread on the previous request.
+    u64 generation = 0;
+    bool request_pending = false;
+    i64 request_step = 0;
+    bool result_ready = false;
+    i64 result_step = 0;
+    Array<Vec2> result;
+};
+
+static i64 get_state_bytes(Timeline const& timeline) {
+    return timeline.masses.size() * 2 * (i64)sizeof(Vec2);
+}
+
+static void compact_state(Slice<Point_Mass const> const point_masses, Array<Vec2>& state) {
+    state.resize(2 * point_masses.size());
+    for(i64 i = 0; i < point_masses.size(); ++i) {
+        state[2 * i] = point_masses[i].position;
+        state[2 * i + 1] = point_masses[i].velocity;
+    }
+}
+
+static void expand_state(Array<Vec2> const& state, Array<f32> const& masses, Slice<Point_Mass> const point_masses) {
+    for(i64 i = 0; i < point_masses.size(); ++i) {
+        point_masses[i] = Point_Mass{state[2 * i], state[2 * i + 1], masses[i]};
+    }
+}
+
+static void permute_state(Array<Vec2>& state, Slice<i64 const> const order, Array<Vec2>& scratch) {
+    scratch = state;
+    for(i64 i = 0; i < order.size(); ++i) {
+        state[2 * i] = scratch[2 * order[i]];
+        state[2 * i + 1] = scratch[2 * order[i] + 1];
+    }
+}
+
+// The background thread never uses the domain decomposition, which would fork a second set of
+// workers competing with the workers of the live simulation.
+static Physics_Settings get_recompute_settings(Physics_Settings settings) {
+    settings.process_count = 1;
+    return settings;
+}
+
+// Must be called with the mutex locked.
+static Stored_State* find_exact_state(Timeline& timeline, i64 const step) {
+    for(Stored_State& keyframe: timeline.keyframes) {
+        if(keyframe.step == step) {
+            return &keyframe;
+        }
+    }
+
+    for(Stored_State& cached: timeline.cache) {
+        if(cached.step == step) {
+            timeline.use_counter += 1;
+            cached.last_use = timeline.use_counter;
+            return &cached;
+        }
+    }
+    return nullptr;
+}
+
+// Must be called with the mutex locked.
+static Stored_State* find_preceding_state(Timeline& timeline, i64 const step) {
+    Stored_State* nearest = nullptr;
+    for(Stored_State& keyframe: timeline.keyframes) {
+        if(keyframe.step <= step && (!nearest || keyframe.step > nearest->step)) {
+            nearest = &keyframe;
+        }
+    }
+
+    for(Stored_State& cached: timeline.cache) {
+        if(cached.step <= step && (!nearest || cached.step > nearest->step)) {
+            nearest = &cached;
+        }
+    }
+    return nearest;
+}
+
+// Must be called with the mutex locked.
+static void insert_cached_state(Timeline& timeline, i64 const step, Slice<Point_Mass const> const point_masses) {
+    i64 const state_bytes = get_state_bytes(timeline);
+    if(state_bytes > timeline.settings.cache_budget || find_exact_state(timeline, step)) {
+        return;
+    }
+
+    // Evict the least recently used states.
+    while(timeline.cache_bytes + state_bytes > timeline.settings.cache_budget) {
+        i64 oldest = 0;
+        for(i64 i = 1; i < timeline.cache.size(); ++i) {
+            if(timeline.cache[i].last_use < timeline.cache[oldest].last_use) {
+                oldest = i;
+            }
+        }
+        timeline.cache.erase_unsorted_unchecked(oldest);
+        timeline.cache_bytes -= state_bytes;
+    }
+
+    timeline.use_counter += 1;
+    Stored_State& cached = timeline.cache.emplace_back(Stored_State{step, Array<Vec2>{}, timeline.use_counter});
+    compact_state(point_masses, cached.state);
+    timeline.cache_bytes += state_bytes;
+}
+
+// Integrates from the nearest stored state preceding target up to target and caches
+// the states on the multiples of the cache stride along the way. Must be called with lock held.
+//
+// Parameters:
+// applied_change - index of the settings change physics_world has been set to.
+//
+// Returns:
+// The step the integration started from or -1 if the request has been superseded.
+//
+static i64 recompute(Timeline& timeline, std::unique_lock<std::mutex>& lock, Physics_World& physics_world, i64& applied_change,
+                     Slice<Point_Mass> const point_masses, i64 const target, u64 const generation, bool const publish) {
+    TRACE_ZONE("timeline_recompute");
+    i64 const stride = timeline.settings.cache_stride;
+    Slice<Point_Mass const> const point_masses_const{point_masses.begin(), point_masses.end()};
+    Stored_State const* const start = find_preceding_state(timeline, target);
+    ANTON_FAIL(start, "no state precedes the target");
+    i64 const start_step = start->step;
+    i64 step = start_step;
+    expand_state(start->state, timeline.masses, point_masses);
+    while(step < target) {
+        i64 change = 0;
+        while(change + 1 < timeline.settings_changes.size() && timeline.settings_changes[change + 1].step <= step) {
+            change += 1;
+        }
+
+        if(change != applied_change) {
+            set_physics_settings(physics_world, get_recompute_settings(timeline.settings_changes[change].settings));
+            applied_change = change;
+        }
+
+        i64 next = math::min((step / stride + 1) * stride, target);
+        if(change + 1 < timeline.settings_changes.size()) {
+            next = math::min(next, timeline.settings_changes[change + 1].step);
+        }
+        lock.unlock();
+        step_physics(physics_world, point_masses, next - step);
+        lock.lock();
+        step = next;
+        if(timeline.generation != generation) {
+            return -1;
+        }
+
+        if(step % stride == 0) {
+            insert_cached_state(timeline, step, point_masses_const);
+        }
+    }
+
+    if(publish) {
+        compact_state(point_masses_const, timeline.result);
+        timeline.result_step = target;
+        timeline.result_ready = true;
+    }
+    return start_step;
+}
+
+static void worker_main(Timeline& timeline) {
+    Physics_World* physics_world = nullptr;
+    i64 applied_change = 0;
+    {
+        std::lock_guard<std::mutex> lock{timeline.mutex};
+        physics_world = create_physics_world(get_recompute_settings(timeline.settings_changes[0].settings));
+    }
+    Array<Point_Mass> point_masses;
+    point_masses.resize(timeline.masses.size());
+    Slice<Point_Mass> const point_masses_slice{point_masses.begin(), point_masses.end()};
+    i64 const stride = timeline.settings.cache_stride;
+    std::unique_lock<std::mutex> lock{timeline.mutex};
+    while(true) {
+        timeline.request_available.wait(lock, [&timeline] { return timeline.quit || timeline.request_pending; });
+        if(timeline.quit) {
+            break;
+        }
+
+        timeline.request_pending = false;
+        u64 const generation = timeline.generation;
+        i64 const start_step = recompute(timeline, lock, *physics_world, applied_change, point_masses_slice, timeline.request_step, generation, true);
+        // Scrubbing usually continues backward. Prepare the segment preceding the one just recomputed.
+        if(start_step > 0) {
+            i64 const previous = ((start_step - 1) / stride) * stride;
+            if(!find_exact_state(timeline, previous)) {
+                recompute(timeline, lock, *physics_world, applied_change, point_masses_slice, previous, generation, false);
+            }
+        }
+    }
+    lock.unlock();
+    destory_physics_world(physics_world);
+}
+
+Timeline* create_timeline(Physics_Settings const& physics_settings, Timeline_Settings const& settings, Slice<Point_Mass const> const initial_state) {
+    ANTON_FAIL(settings.cache_stride > 0 && settings.initial_keyframe_interval > 0, "intervals must be greater than 0");
+    Timeline* const timeline = new Timeline;
+    timeline->settings = settings;
+    timeline->settings_changes.emplace_back(Settings_Change{0, physics_settings});
+    timeline->keyframe_interval = settings.initial_keyframe_interval;
+    timeline->masses.resize(initial_state.size());
+    for(i64 i = 0; i < initial_state.size(); ++i) {
+        timeline->masses[i] = initial_state[i].mass;
+    }
+
+    Stored_State& keyframe = timeline->keyframes.emplace_back(Stored_State{0, Array<Vec2>{}, 0});
+    compact_state(initial_state, keyframe.state);
+    timeline->worker = std::thread(worker_main, std::ref(*timeline));
+    return timeline;
+}
+
+void destroy_timeline(Timeline* const timeline) {
+    {
+        std::lock_guard<std::mutex> lock{timeline->mutex};
+        timeline->quit = true;
+        timeline->generation += 1;
+    }
+    timeline->request_available.notify_one();
+    timeline->worker.join();
+    delete timeline;
+}
+
+void record_timeline_step(Timeline& timeline, Slice<Point_Mass const> const point_masses, i64 const step) {
+    ANTON_FAIL(point_masses.size() == timeline.masses.size(), "the number of point masses has changed");
+    std::lock_guard<std::mutex> lock{timeline.mutex};
+    // Steps before the end are replays of the recorded ones.
+    if(step <= timeline.end) {
+        return;
+    }
+
+    timeline.end = step;
+    if(step - timeline.keyframes.back().step < timeline.keyframe_interval) {
+        return;
+    }
+
+    TRACE_ZONE("timeline_keyframe");
+    Stored_State& keyframe = timeline.keyframes.emplace_back(Stored_State{step, Array<Vec2>{}, 0});
+    compact_state(point_masses, keyframe.state);
+    // Thin the keyframes out while they exceed the budget. The first keyframe is always kept.
+    while(timeline.keyframes.size() > 1 && timeline.keyframes.size() * get_state_bytes(timeline) > timeline.settings.keyframe_budget) {
+        i64 kept = 0;
+        for(i64 i = 0; i < timeline.keyframes.size(); i += 2) {
+            if(i != kept) {
+                timeline.keyframes[kept] = ANTON_MOV(timeline.keyframes[i]);
+            }
+            kept += 1;
+        }
+
+        while(timeline.keyframes.size() > kept) {
+            timeline.keyframes.pop_back();
+        }
+        timeline.keyframe_interval *= 2;
+    }
+}
+
+void record_timeline_settings(Timeline& timeline, Physics_Settings const& settings, i64 const step) {
+    std::lock_guard<std::mutex> lock{timeline.mutex};
+    // The recorded steps keep the settings they have been recorded with.
+    // Of the changes at the same step the latest one applies.
+    timeline.settings_changes.emplace_back(Settings_Change{math::max(step, timeline.end), settings});
+}
+
+void permute_timeline(Timeline& timeline, Slice<i64 const> const order) {
+    TRACE_ZONE("permute_timeline");
+    ANTON_FAIL(order.size() == timeline.masses.size(), "the number of point masses has changed");
+    std::lock_guard<std::mutex> lock{timeline.mutex};
+    // The background thread integrates in the previous order. Discards its work.
+    timeline.generation += 1;
+    timeline.request_pending = false;
+    timeline.result_ready = false;
+
+    Array<f32> const masses = timeline.masses;
+    for(i64 i = 0; i < order.size(); ++i) {
+        timeline.masses[i] = masses[order[i]];
+    }
+
+    Array<Vec2> scratch;
+    for(Stored_State& keyframe: timeline.keyframes) {
+        permute_state(keyframe.state, order, scratch);
+    }
+
+    for(Stored_State& cached: timeline.cache) {
+        permute_state(cached.state, order, scratch);
+    }
+}
+
+i64 get_timeline_end(Timeline const& timeline) {
+    std::lock_guard<std::mutex> lock{timeline.mutex};
+    return timeline.end;
+}
+
+void seek_timeline(Timeline& timeline, i64 const step) {
+    {
+        std::lock_guard<std::mutex> lock{timeline.mutex};
+        i64 const target = math::clamp(step, (i64)0, timeline.end);
+        timeline.generation += 1;
+        timeline.result_ready = false;
+        timeline.request_pending = false;
+        if(Stored_State const* const stored = find_exact_state(timeline, target)) {
+            timeline.result = stored->state;
+            timeline.result_step = target;
+            timeline.result_ready = true;
+            return;
+        }
+
+        timeline.request_pending = true;
+        timeline.request_step = target;
+    }
+    timeline.request_available.notify_one();
+}
+
+void cancel_timeline_seek(Timeline& timeline) {
+    std::lock_guard<std::mutex> lock{timeline.mutex};
+    // Also stops the background thread if it is working on the request.
+    timeline.generation += 1;
+    timeline.request_pending = false;
+    timeline.result_ready = false;
+}
+
+bool poll_timeline(Timeline& timeline, Slice<Point_Mass> const point_masses, i64& step) {
+    ANTON_FAIL(point_masses.size() == timeline.masses.size(), "the number of point masses has changed");
+    std::lock_guard<std::mutex> lock{timeline.mutex};
+    if(!timeline.result_ready) {
+        return false;
+    }
+
+    expand_state(timeline.result, timeline.masses, point_masses);
+    step = timeline.result_step;
+    timeline.result_ready = false;
+    return true;
+}
+
+Timeline_Statistics get_timeline_statistics(Timeline const& timeline) {
+    std::lock_guard<std::mutex> lock{timeline.mutex};
+    return Timeline_Statistics{timeline.keyframes.size(), timeline.keyframe_interval, timeline.keyframes.size() * get_state_bytes(timeline),
+                               timeline.cache.size(), timeline.cache_bytes};
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <anton/slice.hpp>
+#include <build.hpp>
+#include <physics.hpp>
+
+struct Point_Mass;
+struct Timeline;
+
+struct Timeline_Settings {
+    // Memory budget of the keyframes in bytes. When exceeded, every other keyframe
+    // is dropped and the interval between the keyframes doubles.
+    i64 keyframe_budget = 256 * 1024 * 1024;
+    // Memory budget of the cache of recomputed states in bytes.
+    i64 cache_budget = 128 * 1024 * 1024;
+    // Initial interval between the keyframes in substeps.
+    i64 initial_keyframe_interval = 16;
+    // Interval between the cached states in substeps. Seeks should land on its multiples.
+    i64 cache_stride = 4;
+};
+
+// create_timeline
+// Creates a timeline starting at step 0 with initial_state.
+// The state at any recorded step is recomputed with physics_settings and the settings recorded
+// with record_timeline_settings. They must match the settings of the live simulation for the
+// recomputed states to be identical to it.
+//
+[[nodiscard]] Timeline* create_timeline(Physics_Settings const& physics_settings, Timeline_Settings const& settings,
+                                        Slice<Point_Mass const> initial_state);
+void destroy_timeline(Timeline* timeline);
+
+// record_timeline_step
+// Notifies the timeline that the live simulation has reached step. Stores a keyframe when due.
+//
+void record_timeline_step(Timeline& timeline, Slice<Point_Mass const> point_masses, i64 step);
+
+// record_timeline_settings
+// Notifies the timeline that the live simulation uses settings from step on, e.g. after a tuning.
+// A change while the live simulation replays the recorded steps takes effect at the end of the recording.
+//
+void record_timeline_settings(Timeline& timeline, Physics_Settings const& settings, i64 step);
+
+// permute_timeline
+// Applies the reordering of the point masses of the live simulation to the stored masses,
+// keyframes and cached states. Invalidates the pending request.
+//
+// Parameters:
+// order - order[i] is the previous index of the point mass that is now at index i.
+//
+void permute_timeline(Timeline& timeline, Slice<i64 const> order);
+
+// get_timeline_end
+// Returns the latest recorded step.
+//
+[[nodiscard]] i64 get_timeline_end(Timeline const& timeline);
+
+// seek_timeline
+// Requests the state at step. Returns immediately. The state is restored from the nearest
+// preceding keyframe or cached state and integrated forward on a background thread.
+// Replaces the previous request.
+//
+// Parameters:
+// step - in [0, get_timeline_end()].
+//
+void seek_timeline(Timeline& timeline, i64 step);
+
+// cancel_timeline_seek
+// Discards the pending request if any.
+//
+void cancel_timeline_seek(Timeline& timeline);
+
+// poll_timeline
+// Writes the requested state to point_masses if it is ready.
+//
+// Returns:
+// true and the step of the state if the state has been written, false otherwise.
+//
+[[nodiscard]] bool poll_timeline(Timeline& timeline, Slice<Point_Mass> point_masses, i64& step);
+
+struct Timeline_Statistics {
+    i64 keyframe_count;
+    i64 keyframe_interval;
+    i64 keyframe_bytes;
+    i64 cached_state_count;
+    i64 cache_bytes;
+};
+
+[[nodiscard]] Timeline_Statistics get_timeline_statistics(Timeline const& timeline);
@@ -0,0 +1,167 @@
+#include <trace.hpp>
+
+#include <anton/array.hpp>
+#include <anton/filesystem.hpp>
+#include <anton/format.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+enum struct Trace_Event_Type : u8 {
+    zone,
+    counter,
+};
+
+struct Trace_Event {
+    char const* name;
+    i64 begin;
+    // End timestamp of a zone or the value of a counter.
+    i64 value;
+    Trace_Event_Type type;
+};
+
+// Must be a power of 2.
+constexpr i64 trace_buffer_capacity = 65536;
+
+// Single producer ring buffer. Only the owning thread writes, the exporter reads the committed range.
+struct Trace_Buffer {
+    Trace_Event events[trace_buffer_capacity];
+    std::atomic<i64> write_index = 0;
+    // Index of the first event that has not been exported yet.
+    i64 read_index = 0;
+    i64 thread_id = 0;
+};
+
+static std::atomic<bool> tracing_enabled = false;
+static std::mutex buffers_mutex;
+static Array<Trace_Buffer*> buffers;
+static thread_local Trace_Buffer* thread_buffer = nullptr;
+
+static i64 get_timestamp() {
+    auto const now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+static Trace_Buffer* get_thread_buffer() {
+    if(!thread_buffer) {
+        // Registration happens once per thread and is the only place that locks.
+        Trace_Buffer* const buffer = new Trace_Buffer;
+        std::lock_guard<std::mutex> lock{buffers_mutex};
+        buffer->thread_id = buffers.size();
+        buffers.emplace_back(buffer);
+        thread_buffer = buffer;
+    }
+    return thread_buffer;
+}
+
+static void record_event(Trace_Event const& event) {
+    Trace_Buffer* const buffer = get_thread_buffer();
+    i64 const index = buffer->write_index.load(std::memory_order_relaxed);
+    buffer->events[index & (trace_buffer_capacity - 1)] = event;
+    buffer->write_index.store(index + 1, std::memory_order_release);
+}
+
+void set_tracing_enabled(bool const enabled) {
+    tracing_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool is_tracing_enabled() {
+    return tracing_enabled.load(std::memory_order_relaxed);
+}
+
+void trace_counter(char const* const name, i64 const value) {
+    if(!is_tracing_enabled()) {
+        return;
+    }
+
+    record_event(Trace_Event{name, get_timestamp(), value, Trace_Event_Type::counter});
+}
+
+Trace_Zone::Trace_Zone(char const* const name): name(name), begin(-1) {
+    if(is_tracing_enabled()) {
+        begin = get_timestamp();
+    }
+}
+
+Trace_Zone::~Trace_Zone() {
+    if(begin != -1) {
+        record_event(Trace_Event{name, begin, get_timestamp(), Trace_Event_Type::zone});
+    }
+}
+
+// Chrome expects timestamps in microseconds. We keep the nanoseconds as the fractional part.
+static void append_microseconds(String& out, i64 const nanoseconds) {
+    i64 const fraction = nanoseconds % 1000;
+    String_View const padding = fraction < 10 ? String_View{u8"00"} : (fraction < 100 ? String_View{u8"0"} : String_View{u8""});
+    out.append(format(u8"{}.", nanoseconds / 1000));
+    out.append(padding);
+    out.append(format(u8"{}", fraction));
+}
+
+bool export_trace(String const& path) {
+    String json{u8"{\"displayTimeUnit\":\"ns\",\"traceEvents\":["};
+    bool first_event = true;
+    i64 time_origin = -1;
+    {
+        std::lock_guard<std::mutex> lock{buffers_mutex};
+        // Use the earliest recorded timestamp as the origin to keep the numbers short.
+        for(Trace_Buffer* const buffer: buffers) {
+            i64 const write_index = buffer->write_index.load(std::memory_order_acquire);
+            i64 const first = math::max(buffer->read_index, write_index - trace_buffer_capacity);
+            for(i64 i = first; i < write_index; ++i) {
+                i64 const begin = buffer->events[i & (trace_buffer_capacity - 1)].begin;
+                if(time_origin == -1 || begin < time_origin) {
+                    time_origin = begin;
+                }
+            }
+        }
+
+        for(Trace_Buffer* const buffer: buffers) {
+            if(!first_event) {
+                json.append(u8",");
+            }
+            first_event = false;
+            json.append(u8"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":");
+            json.append(format(u8"{}", buffer->thread_id));
+            json.append(u8",\"args\":{\"name\":\"thread ");
+            json.append(format(u8"{}", buffer->thread_id));
+            json.append(u8"\"}}");
+
+            i64 const write_index = buffer->write_index.load(std::memory_order_acquire);
+            i64 const first = math::max(buffer->read_index, write_index - trace_buffer_capacity);
+            for(i64 i = first; i < write_index; ++i) {
+                Trace_Event const& event = buffer->events[i & (trace_buffer_capacity - 1)];
+                json.append(u8",{\"name\":\"");
+                json.append(String_View{event.name});
+                json.append(u8"\",\"pid\":1,\"tid\":");
+                json.append(format(u8"{}", buffer->thread_id));
+                json.append(u8",\"ts\":");
+                append_microseconds(json, event.begin - time_origin);
+                if(event.type == Trace_Event_Type::zone) {
+                    json.append(u8",\"ph\":\"X\",\"dur\":");
+                    append_microseconds(json, event.value - event.begin);
+                    json.append(u8"}");
+                } else {
+                    json.append(u8",\"ph\":\"C\",\"args\":{\"value\":");
+                    json.append(format(u8"{}", event.value));
+                    json.append(u8"}}");
+                }
+            }
+
+            // Only the newest trace_buffer_capacity events survive. The exporter is meant to run
+            // between frames when the workers are idle, otherwise a few events might be torn.
+            buffer->read_index = write_index;
+        }
+    }
+    json.append(u8"]}\n");
+
+    fs::Output_File_Stream stream;
+    if(!stream.open(path)) {
+        return false;
+    }
+
+    stream.write(json.data(), json.size_bytes());
+    stream.close();
+    return true;
+}
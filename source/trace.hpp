@@ -0,0 +1,53 @@
+#pragma once
+
+#include <anton/string.hpp>
+#include <build.hpp>
+
+// Lightweight scoped trace zones and counters.
+// Every thread records into its own fixed size ring buffer without taking any locks.
+// When tracing is compiled in, but not enabled, a zone costs a single relaxed atomic load.
+// The recorded data is exported in the Chrome trace-event JSON format.
+
+void set_tracing_enabled(bool enabled);
+[[nodiscard]] bool is_tracing_enabled();
+
+// trace_counter
+// Records the value of a named counter at the current time.
+//
+// Parameters:
+// name - name of the counter. Must have static storage duration.
+//
+void trace_counter(char const* name, i64 value);
+
+// export_trace
+// Writes all events recorded so far as Chrome trace-event JSON and clears the buffers.
+//
+// Returns:
+// true if the file has been written successfully.
+//
+bool export_trace(String const& path);
+
+struct Trace_Zone {
+public:
+    // name must have static storage duration.
+    Trace_Zone(char const* name);
+    Trace_Zone(Trace_Zone const&) = delete;
+    Trace_Zone& operator=(Trace_Zone const&) = delete;
+    ~Trace_Zone();
+
+private:
+    char const* name;
+    i64 begin;
+};
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+#if GRAVITY_SIMULATION_TRACING
+    #define TRACE_ZONE(name) Trace_Zone const TRACE_CONCAT(trace_zone_, __LINE__){name}
+    #define TRACE_COUNTER(name, value) trace_counter(name, value)
+#else
+    #define TRACE_ZONE(name)
+    // Keep the value referenced, but unevaluated, so that variables used only for tracing do not warn.
+    #define TRACE_COUNTER(name, value) ((void)sizeof(value))
+#endif
@@ -0,0 +1,84 @@
+#include <tracer.hpp>
+
+#include <gravity.hpp>
+#include <point_mass.hpp>
+#include <threads.hpp>
+#include <trace.hpp>
+
+#include <cmath>
+
+// Number of tracers processed by a single task. The scratch of a block lives on the stack.
+constexpr i64 tracer_block_size = 1024;
+
+void add_tracer(Tracer_Cloud& cloud, Vec2 const position, Vec2 const velocity) {
+    cloud.position_x.emplace_back(position.x);
+    cloud.position_y.emplace_back(position.y);
+    cloud.velocity_x.emplace_back(velocity.x);
+    cloud.velocity_y.emplace_back(velocity.y);
+}
+
+i64 get_tracer_count(Tracer_Cloud const& cloud) {
+    return cloud.position_x.size();
+}
+
+// Accelerations of count tracers at (x, y) exerted by the sources.
+// The loop over the tracers is branch-free and vectorizes.
+template<typename Kernel>
+static void accumulate_tracer_accelerations(Slice<Point_Mass const> const sources, f32 const* const x, f32 const* const y, f32* const ax, f32* const ay,
+                                            i64 const count, f32 const softening_length) {
+    for(i64 i = 0; i < count; ++i) {
+        ax[i] = 0.0f;
+        ay[i] = 0.0f;
+    }
+
+    for(Point_Mass const& source: sources) {
+        f32 const source_x = source.position.x;
+        f32 const source_y = source.position.y;
+        f32 const gm = gravitational_constant * source.mass;
+        for(i64 i = 0; i < count; ++i) {
+            f32 const dx = source_x - x[i];
+            f32 const dy = source_y - y[i];
+            f32 const factor = Kernel::get_force_factor(dx * dx + dy * dy, softening_length);
+            ax[i] += gm * dx * factor;
+            ay[i] += gm * dy * factor;
+        }
+    }
+}
+
+void step_tracers(Physics_Settings const& settings, Slice<Point_Mass const> const sources, Tracer_Cloud& cloud) {
+    TRACE_ZONE("step_tracers");
+    f32 const timestep = settings.timestep;
+    f32 const softening_length = settings.softening_length;
+    with_softening_kernel(settings.softening, [&](auto const kernel) {
+        using Kernel = decltype(kernel);
+        parallel_for(get_tracer_count(cloud), tracer_block_size, settings.thread_count, [&cloud, sources, timestep, softening_length](i64 const begin, i64 const end) {
+            i64 const count = end - begin;
+            f32* const x = cloud.position_x.data() + begin;
+            f32* const y = cloud.position_y.data() + begin;
+            f32* const vx = cloud.velocity_x.data() + begin;
+            f32* const vy = cloud.velocity_y.data() + begin;
+            f32 ax1[tracer_block_size];
+            f32 ay1[tracer_block_size];
+            f32 ax2[tracer_block_size];
+            f32 ay2[tracer_block_size];
+            f32 x_next[tracer_block_size];
+            f32 y_next[tracer_block_size];
+            // Sum of accelerations at t
+            accumulate_tracer_accelerations<Kernel>(sources, x, y, ax1, ay1, count, softening_length);
+            for(i64 i = 0; i < count; ++i) {
+                x_next[i] = x[i] + vx[i] * timestep + 0.5f * ax1[i] * timestep * timestep;
+                y_next[i] = y[i] + vy[i] * timestep + 0.5f * ay1[i] * timestep * timestep;
+            }
+
+            // Sum of accelerations at t+dt with the sources at t
+            accumulate_tracer_accelerations<Kernel>(sources, x_next, y_next, ax2, ay2, count, softening_length);
+            for(i64 i = 0; i < count; ++i) {
+                x[i] = x_next[i];
+                y[i] = y_next[i];
+                vx[i] += 0.5f * (ax1[i] + ax2[i]) * timestep;
+                vy[i] += 0.5f * (ay1[i] + ay2[i]) * timestep;
+            }
+        });
+    });
+    TRACE_COUNTER("tracer_interactions", 2 * sources.size() * get_tracer_count(cloud));
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <anton/array.hpp>
+#include <anton/math/vec2.hpp>
+#include <anton/math/vec4.hpp>
+#include <anton/slice.hpp>
+#include <build.hpp>
+#include <physics.hpp>
+
+struct Point_Mass;
+
+// Tracer_Cloud
+// Massless test particles that feel the gravity of the point masses but exert none.
+// The tracers are stored as a structure of arrays so that their integration vectorizes.
+//
+struct Tracer_Cloud {
+    Array<f32> position_x;
+    Array<f32> position_y;
+    Array<f32> velocity_x;
+    Array<f32> velocity_y;
+    Vec4 color{0.45f, 0.8f, 1.0f, 0.5f};
+    // Size of a tracer on the screen in pixels.
+    f32 point_size = 1.0f;
+};
+
+void add_tracer(Tracer_Cloud& cloud, Vec2 position, Vec2 velocity);
+
+[[nodiscard]] i64 get_tracer_count(Tracer_Cloud const& cloud);
+
+// step_tracers
+// Advances the tracers by a single substep with the scheme of step_physics. The sources
+// remain at their positions at the beginning of the substep. The cost is linear in both
+// the number of sources and the number of tracers.
+//
+void step_tracers(Physics_Settings const& settings, Slice<Point_Mass const> sources, Tracer_Cloud& cloud);
@@ -0,0 +1,240 @@
+#include <trails.hpp>
+
+#include <point_mass.hpp>
+#include <trace.hpp>
+
+#include <cmath>
+
+constexpr f32 quantization_range = 32767.0f;
+// Headroom of the quantization range so that the origin is not moved every point.
+constexpr f32 quantization_headroom = 2.0f;
+// Smallest quantization step in meters.
+constexpr f32 min_quantization_scale = 1.0e-3f;
+
+static Vec2 decode(Trail_Body const& body, Trail_Point const point) {
+    return body.origin + Vec2{(f32)point.x, (f32)point.y} * body.scale;
+}
+
+static bool is_encodable(Trail_Body const& body, Vec2 const position) {
+    Vec2 const offset = (position - body.origin) / body.scale;
+    return body.scale > 0.0f && math::abs(offset.x) <= quantization_range && math::abs(offset.y) <= quantization_range;
+}
+
+static Trail_Point encode(Trail_Body const& body, Vec2 const position) {
+    Vec2 const offset = (position - body.origin) / body.scale;
+    return Trail_Point{(i16)std::lround(offset.x), (i16)std::lround(offset.y)};
+}
+
+// Moves the origin of the quantization to position and picks a scale that covers
+// every point of the trail but skip_slot, which is about to be overwritten.
+// The points are requantized. The vertices already on the gpu are not rewritten.
+static void rebase(Trail_Body& body, Trail_Point* const points, i32 const capacity, Vec2 const position, i32 const skip_slot) {
+    f32 range = 0.0f;
+    for(i32 i = 0; i < body.count; ++i) {
+        i32 const slot = (body.head - i + capacity) % capacity;
+        if(slot == skip_slot) {
+            continue;
+        }
+
+        Vec2 const offset = decode(body, points[slot]) - position;
+        range = math::max(range, math::max(math::abs(offset.x), math::abs(offset.y)));
+    }
+
+    Trail_Body rebased = body;
+    rebased.origin = position;
+    rebased.scale = math::max(quantization_headroom * range / quantization_range, min_quantization_scale);
+    for(i32 i = 0; i < body.count; ++i) {
+        i32 const slot = (body.head - i + capacity) % capacity;
+        points[slot] = encode(rebased, decode(body, points[slot]));
+    }
+    body = rebased;
+}
+
+static void write_slot(Orbit_Trails& trails, i64 const body_index, i32 const slot, Vec2 const position) {
+    Trail_Body& body = trails.bodies[body_index];
+    Trail_Point* const points = trails.points.data() + body_index * trails.points_per_body;
+    if(!is_encodable(body, position)) {
+        rebase(body, points, trails.points_per_body, position, slot);
+    }
+
+    points[slot] = encode(body, position);
+    if(!trails.upload_all) {
+        trails.dirty_slots.emplace_back(body_index * trails.points_per_body + slot);
+        // Nothing has been uploaded in a while. Upload everything next time instead.
+        if(trails.dirty_slots.size() > trails.points.size()) {
+            trails.dirty_slots.clear();
+            trails.upload_all = true;
+        }
+    }
+}
+
+static void append_point(Orbit_Trails& trails, i64 const body_index, Vec2 const position) {
+    Trail_Body& body = trails.bodies[body_index];
+    if(body.count > 0) {
+        body.head = (body.head + 1) % trails.points_per_body;
+    }
+    body.count = math::min(body.count + 1, trails.points_per_body);
+    write_slot(trails, body_index, body.head, position);
+}
+
+// Starts a new tentative point at position with the cone of the directions from the anchor.
+static void begin_segment(Orbit_Trails& trails, i64 const body_index, Vec2 const position, Vec2 const direction) {
+    Trail_Body& body = trails.bodies[body_index];
+    body.tentative = position;
+    body.has_tentative = true;
+    body.reference_direction = direction;
+    body.angle_min = -trails.angular_tolerance;
+    body.angle_max = trails.angular_tolerance;
+    append_point(trails, body_index, position);
+}
+
+void update_orbit_trails(Orbit_Trails& trails, Slice<Point_Mass const> const point_masses) {
+    TRACE_ZONE("update_orbit_trails");
+    if(trails.bodies.size() != point_masses.size()) {
+        trails.bodies.resize(point_masses.size());
+        trails.points.resize(point_masses.size() * trails.points_per_body);
+        clear_orbit_trails(trails);
+    }
+
+    for(i64 i = 0; i < point_masses.size(); ++i) {
+        Trail_Body& body = trails.bodies[i];
+        Vec2 const position = point_masses[i].position;
+        if(body.count == 0) {
+            body.anchor = position;
+            body.has_tentative = false;
+            append_point(trails, i, position);
+            continue;
+        }
+
+        Vec2 const offset = position - body.anchor;
+        f32 const length = math::length(offset);
+        if(length <= 0.0f) {
+            continue;
+        }
+
+        Vec2 const direction = offset / length;
+        if(!body.has_tentative) {
+            begin_segment(trails, i, position, direction);
+            continue;
+        }
+
+        Vec2 const reference = body.reference_direction;
+        f32 const angle = std::atan2(reference.x * direction.y - reference.y * direction.x, reference.x * direction.x + reference.y * direction.y);
+        if(angle >= body.angle_min && angle <= body.angle_max) {
+            // Still collinear. Move the tentative point and narrow the cone.
+            body.tentative = position;
+            body.angle_min = math::max(body.angle_min, angle - trails.angular_tolerance);
+            body.angle_max = math::min(body.angle_max, angle + trails.angular_tolerance);
+            write_slot(trails, i, body.head, position);
+        } else {
+            // Keep the tentative point and start the next segment from it.
+            body.anchor = body.tentative;
+            Vec2 const next_offset = position - body.anchor;
+            f32 const next_length = math::length(next_offset);
+            if(next_length <= 0.0f) {
+                body.has_tentative = false;
+                continue;
+            }
+            begin_segment(trails, i, position, next_offset / next_length);
+        }
+    }
+}
+
+void clear_orbit_trails(Orbit_Trails& trails) {
+    for(Trail_Body& body: trails.bodies) {
+        body = Trail_Body{};
+    }
+    trails.dirty_slots.clear();
+    trails.upload_all = true;
+}
+
+void permute_orbit_trails(Orbit_Trails& trails, Slice<i64 const> const order) {
+    TRACE_ZONE("permute_orbit_trails");
+    if(trails.bodies.size() != order.size()) {
+        // Cleared by the next update anyway.
+        return;
+    }
+
+    i64 const points_per_body = trails.points_per_body;
+    Array<Trail_Body> const bodies = trails.bodies;
+    Array<Trail_Point> const points = trails.points;
+    for(i64 i = 0; i < order.size(); ++i) {
+        i64 const previous = order[i];
+        trails.bodies[i] = bodies[previous];
+        for(i64 slot = 0; slot < points_per_body; ++slot) {
+            trails.points[i * points_per_body + slot] = points[previous * points_per_body + slot];
+        }
+    }
+    trails.dirty_slots.clear();
+    trails.upload_all = true;
+}
+
+i64 get_orbit_trail_vertex_count(Orbit_Trails const& trails) {
+    return trails.bodies.size() * (trails.points_per_body + 1);
+}
+
+i64 write_orbit_trail_vertices(Orbit_Trails& trails, Vec2* const vertices, bool const all, Array<i64>* const written_vertices) {
+    TRACE_ZONE("write_orbit_trail_vertices");
+    i64 const points_per_body = trails.points_per_body;
+    i64 written = 0;
+    auto write = [&trails, vertices, written_vertices, points_per_body, &written](i64 const body_index, i64 const slot) {
+        Trail_Body const& body = trails.bodies[body_index];
+        Vec2 const position = decode(body, trails.points[body_index * points_per_body + slot]);
+        i64 const first_vertex = body_index * (points_per_body + 1);
+        vertices[first_vertex + slot] = position;
+        written += 1;
+        if(written_vertices != nullptr) {
+            written_vertices->emplace_back(first_vertex + slot);
+        }
+        if(slot == 0) {
+            vertices[first_vertex + points_per_body] = position;
+            written += 1;
+            if(written_vertices != nullptr) {
+                written_vertices->emplace_back(first_vertex + points_per_body);
+            }
+        }
+    };
+
+    if(all || trails.upload_all) {
+        for(i64 i = 0; i < trails.bodies.size(); ++i) {
+            for(i64 slot = 0; slot < trails.bodies[i].count; ++slot) {
+                write(i, slot);
+            }
+        }
+    } else {
+        for(i64 const dirty_slot: trails.dirty_slots) {
+            write(dirty_slot / points_per_body, dirty_slot % points_per_body);
+        }
+    }
+
+    trails.dirty_slots.clear();
+    trails.upload_all = false;
+    return written;
+}
+
+i64 get_orbit_trail_strips(Orbit_Trails const& trails, i32* const firsts, i32* const counts) {
+    i32 const points_per_body = trails.points_per_body;
+    i64 strip_count = 0;
+    for(i64 i = 0; i < trails.bodies.size(); ++i) {
+        Trail_Body const& body = trails.bodies[i];
+        if(body.count < 2) {
+            continue;
+        }
+
+        i32 const base = (i32)(i * (points_per_body + 1));
+        i32 const oldest = (body.head - body.count + 1 + points_per_body) % points_per_body;
+        if(oldest + body.count <= points_per_body) {
+            firsts[strip_count] = base + oldest;
+            counts[strip_count] = body.count;
+            strip_count += 1;
+        } else {
+            // Through the repeated first slot, then from the first slot to the newest point.
+            firsts[strip_count] = base + oldest;
+            counts[strip_count] = points_per_body - oldest + 1;
+            firsts[strip_count + 1] = base;
+            counts[strip_count + 1] = body.head + 1;
+            strip_count += 2;
+        }
+    }
+    return strip_count;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <anton/array.hpp>
+#include <anton/math/vec2.hpp>
+#include <anton/math/vec4.hpp>
+#include <anton/slice.hpp>
+#include <build.hpp>
+
+struct Point_Mass;
+
+struct Trail_Point {
+    i16 x;
+    i16 y;
+};
+
+struct Trail_Body {
+    // The points are stored quantized relative to origin in units of scale meters.
+    Vec2 origin;
+    f32 scale = 0.0f;
+    // Slot of the newest point.
+    i32 head = 0;
+    i32 count = 0;
+    // The last kept point and the newest point which is replaced for as long as
+    // the points after anchor remain collinear.
+    Vec2 anchor;
+    Vec2 tentative;
+    bool has_tentative = false;
+    // Directions from anchor that keep the skipped points within the tolerance.
+    // Angles relative to reference_direction.
+    Vec2 reference_direction;
+    f32 angle_min = 0.0f;
+    f32 angle_max = 0.0f;
+};
+
+// Orbit_Trails
+// Fixed memory history of the positions of the point masses. Every body owns a ring of
+// points_per_body points. A point is only kept when the following points deviate from
+// the straight line through it by more than angular_tolerance, hence a trail covers
+// straight motion with few points.
+// At most one Orbit_Trails may exist in the world.
+//
+struct Orbit_Trails {
+    i32 points_per_body = 256;
+    // Largest angle in radians between a dropped point and the segment that replaces it
+    // as seen from the start of the segment.
+    f32 angular_tolerance = 0.01f;
+    Vec4 color{0.698f, 0.29f, 1.0f, 0.45f};
+    bool enabled = true;
+
+    Array<Trail_Body> bodies;
+    Array<Trail_Point> points;
+    // Slots written since the last upload in units of points.
+    Array<i64> dirty_slots;
+    bool upload_all = true;
+};
+
+// update_orbit_trails
+// Appends the current positions of the point masses to their trails.
+// The trails are cleared when the number of point masses changes.
+//
+void update_orbit_trails(Orbit_Trails& trails, Slice<Point_Mass const> point_masses);
+
+// clear_orbit_trails
+// Removes all points, e.g. when the simulation jumps in time.
+//
+void clear_orbit_trails(Orbit_Trails& trails);
+
+// permute_orbit_trails
+// Moves the trails along when the point masses are reordered.
+//
+// Parameters:
+// order - order[i] is the previous index of the point mass that is now at index i.
+//
+void permute_orbit_trails(Orbit_Trails& trails, Slice<i64 const> order);
+
+// get_orbit_trail_vertex_count
+// Number of vertices of the trails on the gpu. Every body owns points_per_body + 1
+// vertices, the last one repeats the first slot so that a wrapped ring is a line strip.
+//
+[[nodiscard]] i64 get_orbit_trail_vertex_count(Orbit_Trails const& trails);
+
+// write_orbit_trail_vertices
+// Writes the slots that changed since the previous call to the vertex buffer.
+// Every slot is written when upload_all is set.
+//
+// Parameters:
+//         vertices - get_orbit_trail_vertex_count vertices.
+//              all - write every slot, e.g. after the vertex buffer has been reallocated.
+// written_vertices - receives the indices of the written vertices. May be nullptr.
+//
+// Returns:
+// The number of vertices written.
+//
+i64 write_orbit_trail_vertices(Orbit_Trails& trails, Vec2* vertices, bool all, Array<i64>* written_vertices);
+
+// get_orbit_trail_strips
+// Writes the line strips of the trails into firsts and counts. A trail consists of
+// at most 2 strips.
+//
+// Parameters:
+// firsts, counts - 2 * number of bodies elements.
+//
+// Returns:
+// The number of strips.
+//
+i64 get_orbit_trail_strips(Orbit_Trails const& trails, i32* firsts, i32* counts);
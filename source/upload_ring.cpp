@@ -0,0 +1,137 @@
+#include <upload_ring.hpp>
+
+#include <anton/array.hpp>
+#include <anton/assert.hpp>
+#include <trace.hpp>
+
+#include <glad/glad.h>
+
+// Largest supported alignment. The regions are multiples of it, so that an offset aligned
+// within a region is aligned within the buffer.
+constexpr i64 max_upload_alignment = 256;
+
+// Buffer replaced by a larger one. Kept alive and mapped until the last frame that used it has finished,
+// since its name is still bound and read by the commands of that frame and of the frames in flight.
+struct Retired_Buffer {
+    u32 buffer;
+    // Number of the last frame that used the buffer.
+    i64 frame;
+};
+
+struct Upload_Ring {
+    u32 buffer = 0;
+    u8* mapped = nullptr;
+    i64 region_size = 0;
+    // Fence of the last frame that used each region.
+    Array<GLsync> fences;
+    i32 slot = 0;
+    // Bytes of the region of the current frame that have been allocated.
+    i64 used = 0;
+    // Offset of the latest allocation in the region.
+    i64 last_offset = 0;
+    // Number of the current frame. The slot of frame n is n % fences.size().
+    i64 frame = 0;
+    Array<Retired_Buffer> retired;
+};
+
+static void delete_ring_buffer(u32 const buffer) {
+    glUnmapNamedBuffer(buffer);
+    glDeleteBuffers(1, &buffer);
+}
+
+static void allocate_ring_buffer(Upload_Ring& ring, i64 const region_size) {
+    ring.region_size = (region_size + max_upload_alignment - 1) / max_upload_alignment * max_upload_alignment;
+    i64 const size = ring.region_size * ring.fences.size();
+    glCreateBuffers(1, &ring.buffer);
+    glNamedBufferStorage(ring.buffer, size, nullptr, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+    ring.mapped = (u8*)glMapNamedBufferRange(ring.buffer, 0, size, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+}
+
+Upload_Ring* create_upload_ring(i32 const frame_count, i64 const region_size) {
+    Upload_Ring* const ring = new Upload_Ring;
+    ring->fences.resize(math::max(frame_count, 1), nullptr);
+    allocate_ring_buffer(*ring, math::max(region_size, max_upload_alignment));
+    return ring;
+}
+
+void destroy_upload_ring(Upload_Ring* const ring) {
+    for(GLsync const fence: ring->fences) {
+        if(fence != nullptr) {
+            glDeleteSync(fence);
+        }
+    }
+    for(Retired_Buffer const& retired: ring->retired) {
+        delete_ring_buffer(retired.buffer);
+    }
+    delete_ring_buffer(ring->buffer);
+    delete ring;
+}
+
+void begin_upload_frame(Upload_Ring& ring) {
+    ring.frame += 1;
+    ring.slot = ring.frame % ring.fences.size();
+    ring.used = 0;
+    ring.last_offset = 0;
+    GLsync& fence = ring.fences[ring.slot];
+    if(fence != nullptr) {
+        TRACE_ZONE("wait_upload_fence");
+        while(true) {
+            // Waits in steps of a second.
+            GLenum const status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            if(status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+                break;
+            }
+
+            ANTON_FAIL(status != GL_WAIT_FAILED, "waiting for the upload fence failed");
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    // The fences signal in order, hence every frame up to the one that used the slot last has finished.
+    i64 const finished_frame = ring.frame - ring.fences.size();
+    for(i64 i = 0; i < ring.retired.size();) {
+        if(ring.retired[i].frame <= finished_frame) {
+            delete_ring_buffer(ring.retired[i].buffer);
+            ring.retired.erase_unsorted_unchecked(i);
+        } else {
+            i += 1;
+        }
+    }
+}
+
+void end_upload_frame(Upload_Ring& ring) {
+    GLsync& fence = ring.fences[ring.slot];
+    ANTON_ASSERT(fence == nullptr, "upload frame ended twice");
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+i32 get_upload_frame_slot(Upload_Ring const& ring) {
+    return ring.slot;
+}
+
+Upload_Allocation allocate_upload(Upload_Ring& ring, i64 const size, i64 const alignment) {
+    ANTON_ASSERT(alignment > 0 && alignment <= max_upload_alignment && (alignment & (alignment - 1)) == 0, "unsupported alignment");
+    i64 offset = (ring.used + alignment - 1) & ~(alignment - 1);
+    if(offset + size > ring.region_size) {
+        // The previous allocations of the frame and the regions of the frames in flight stay in the old
+        // buffer, which is retired rather than deleted, so that its bindings and mapping remain valid.
+        // The fences are kept since they also guard the data multi-buffered by the slot.
+        TRACE_ZONE("grow_upload_ring");
+        ring.retired.emplace_back(Retired_Buffer{ring.buffer, ring.frame});
+        allocate_ring_buffer(ring, math::max(2 * ring.region_size, size + alignment));
+        ring.used = 0;
+        offset = 0;
+    }
+
+    ring.used = offset + size;
+    ring.last_offset = offset;
+    i64 const buffer_offset = ring.slot * ring.region_size + offset;
+    return Upload_Allocation{ring.buffer, buffer_offset, size, ring.mapped + buffer_offset};
+}
+
+void trim_upload(Upload_Ring& ring, Upload_Allocation& allocation, i64 const used_size) {
+    ANTON_ASSERT(allocation.offset == ring.slot * ring.region_size + ring.last_offset && allocation.buffer == ring.buffer, "only the latest allocation may be trimmed");
+    allocation.size = math::min(allocation.size, used_size);
+    ring.used = ring.last_offset + allocation.size;
+}
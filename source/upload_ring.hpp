@@ -0,0 +1,54 @@
+#pragma once
+
+#include <build.hpp>
+
+struct Upload_Ring;
+
+struct Upload_Allocation {
+    u32 buffer;
+    // Offset of the allocation in buffer in bytes.
+    i64 offset;
+    i64 size;
+    void* mapped;
+};
+
+// create_upload_ring
+// Creates a persistently mapped buffer divided into frame_count regions. Every frame writes
+// to its own region while the gpu may still read the regions of the preceding frames.
+// The regions grow when the allocations of a frame do not fit.
+//
+[[nodiscard]] Upload_Ring* create_upload_ring(i32 frame_count, i64 region_size);
+void destroy_upload_ring(Upload_Ring* ring);
+
+// begin_upload_frame
+// Moves to the region of the next frame and waits until the gpu has finished the frame
+// that used the region before.
+//
+void begin_upload_frame(Upload_Ring& ring);
+
+// end_upload_frame
+// Fences the region of the current frame. Must be called after the last command that
+// reads the allocations of the frame.
+//
+void end_upload_frame(Upload_Ring& ring);
+
+// get_upload_frame_slot
+// Index of the region of the current frame. Data that persists between frames may be
+// multi-buffered by the slot, since begin_upload_frame guarantees that the gpu has
+// finished the last frame with the same slot.
+//
+[[nodiscard]] i32 get_upload_frame_slot(Upload_Ring const& ring);
+
+// allocate_upload
+// Allocates size bytes in the region of the current frame. The allocation is valid until the end
+// of the frame. The allocations made earlier in the frame remain valid when the ring grows.
+//
+// Parameters:
+// alignment - power of 2 of at most 256.
+//
+[[nodiscard]] Upload_Allocation allocate_upload(Upload_Ring& ring, i64 size, i64 alignment);
+
+// trim_upload
+// Returns the end of the latest allocation past used_size to the ring.
+//
+void trim_upload(Upload_Ring& ring, Upload_Allocation& allocation, i64 used_size);
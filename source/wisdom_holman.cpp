@@ -0,0 +1,273 @@
+#include <wisdom_holman.hpp>
+
+#include <arena.hpp>
+#include <gravity.hpp>
+#include <point_mass.hpp>
+#include <threads.hpp>
+#include <trace.hpp>
+
+#include <cmath>
+
+constexpr f64 gravitational_constant_f64 = 6.67408e-11;
+// Number of bodies processed by a single task.
+constexpr i64 target_block_size = 64;
+constexpr i32 max_kepler_iterations = 32;
+// Depth of the subdivision of a Kepler drift that does not converge.
+constexpr i32 max_kepler_subdivisions = 8;
+
+// Stumpff functions c_k(x) = sum_n (-x)^n / (2n + k)!
+static void compute_stumpff(f64 const x, f64& c0, f64& c1, f64& c2, f64& c3) {
+    if(std::abs(x) < 1.0) {
+        c2 = 0.0;
+        c3 = 0.0;
+        f64 term2 = 1.0 / 2.0;
+        f64 term3 = 1.0 / 6.0;
+        for(i32 n = 0; n < 12; ++n) {
+            c2 += term2;
+            c3 += term3;
+            term2 *= -x / ((2.0 * n + 3.0) * (2.0 * n + 4.0));
+            term3 *= -x / ((2.0 * n + 4.0) * (2.0 * n + 5.0));
+        }
+    } else if(x > 0.0) {
+        f64 const z = std::sqrt(x);
+        c2 = (1.0 - std::cos(z)) / x;
+        c3 = (z - std::sin(z)) / (x * z);
+    } else {
+        f64 const z = std::sqrt(-x);
+        c2 = (std::cosh(z) - 1.0) / -x;
+        c3 = (std::sinh(z) - z) / (-x * z);
+    }
+    c1 = 1.0 - x * c3;
+    c0 = 1.0 - x * c2;
+}
+
+// Advances the position and velocity relative to the central body along the Kepler
+// orbit by dt. Solves the universal Kepler equation for the universal anomaly s with
+// Newton's method and applies the f and g functions.
+//
+// Returns:
+// false if the solver did not converge. The state is not modified then.
+//
+static bool kepler_drift(f64 const mu, f64 const dt, f64& x, f64& y, f64& vx, f64& vy) {
+    f64 const r0 = std::sqrt(x * x + y * y);
+    // The drift follows the exact Newtonian orbit around the central body, which is not softened,
+    // since a softened central potential has no closed form orbit. The softening applies to the kicks.
+    // A body at the position of the central body has no defined orbit.
+    if(r0 == 0.0) {
+        x += vx * dt;
+        y += vy * dt;
+        return true;
+    }
+
+    f64 const eta0 = x * vx + y * vy;
+    f64 const beta = 2.0 * mu / r0 - (vx * vx + vy * vy);
+    f64 s = dt / r0;
+    f64 c0, c1, c2, c3;
+    bool converged = false;
+    for(i32 i = 0; i < max_kepler_iterations; ++i) {
+        compute_stumpff(beta * s * s, c0, c1, c2, c3);
+        f64 const residual = r0 * s * c1 + eta0 * s * s * c2 + mu * s * s * s * c3 - dt;
+        f64 const r = r0 * c0 + eta0 * s * c1 + mu * s * s * c2;
+        f64 const ds = residual / r;
+        s -= ds;
+        if(std::abs(ds) <= 1.0e-14 * std::abs(s)) {
+            converged = true;
+            break;
+        }
+    }
+
+    if(!converged || !std::isfinite(s)) {
+        return false;
+    }
+
+    compute_stumpff(beta * s * s, c0, c1, c2, c3);
+    f64 const r = r0 * c0 + eta0 * s * c1 + mu * s * s * c2;
+    f64 const f = 1.0 - mu * s * s * c2 / r0;
+    f64 const g = dt - mu * s * s * s * c3;
+    f64 const f_dot = -mu * s * c1 / (r * r0);
+    f64 const g_dot = 1.0 - mu * s * s * c2 / r;
+    f64 const x_new = f * x + g * vx;
+    f64 const y_new = f * y + g * vy;
+    f64 const vx_new = f_dot * x + g_dot * vx;
+    f64 const vy_new = f_dot * y + g_dot * vy;
+    x = x_new;
+    y = y_new;
+    vx = vx_new;
+    vy = vy_new;
+    return true;
+}
+
+// Halves the drift until the solver converges.
+static void kepler_drift_subdivided(f64 const mu, f64 const dt, f64& x, f64& y, f64& vx, f64& vy, i32 const depth) {
+    if(kepler_drift(mu, dt, x, y, vx, vy)) {
+        return;
+    }
+
+    if(depth >= max_kepler_subdivisions) {
+        x += vx * dt;
+        y += vy * dt;
+        return;
+    }
+
+    kepler_drift_subdivided(mu, 0.5 * dt, x, y, vx, vy, depth + 1);
+    kepler_drift_subdivided(mu, 0.5 * dt, x, y, vx, vy, depth + 1);
+}
+
+void step_wisdom_holman(Physics_Settings const& settings, Arena_Allocator& arena, Slice<Point_Mass> const point_masses, i64 const step_count) {
+    TRACE_ZONE("step_wisdom_holman");
+    i64 const count = point_masses.size();
+    f64 const timestep = settings.timestep;
+    f64 total_mass = 0.0;
+    for(Point_Mass const& point_mass: point_masses) {
+        total_mass += point_mass.mass;
+    }
+
+    if(count < 2 || total_mass <= 0.0) {
+        for(Point_Mass& point_mass: point_masses) {
+            point_mass.position += point_mass.velocity * (f32)(timestep * step_count);
+        }
+        return;
+    }
+
+    i64 central = 0;
+    for(i64 i = 1; i < count; ++i) {
+        if(point_masses[i].mass > point_masses[central].mass) {
+            central = i;
+        }
+    }
+
+    // Democratic heliocentric coordinates. Positions relative to the central body,
+    // velocities relative to the center of mass. The central body is excluded from the arrays.
+    arena.reset();
+    Polymorphic_Allocator const allocator{&arena};
+    i64 const n = count - 1;
+    Arena_Array<f64> qx{allocator};
+    qx.resize(n);
+    Arena_Array<f64> qy{allocator};
+    qy.resize(n);
+    Arena_Array<f64> vx{allocator};
+    vx.resize(n);
+    Arena_Array<f64> vy{allocator};
+    vy.resize(n);
+    Arena_Array<f64> masses{allocator};
+    masses.resize(n);
+
+    Point_Mass const& central_body = point_masses[central];
+    f64 const central_mass = central_body.mass;
+    f64 center_x = 0.0;
+    f64 center_y = 0.0;
+    f64 center_vx = 0.0;
+    f64 center_vy = 0.0;
+    for(Point_Mass const& point_mass: point_masses) {
+        center_x += (f64)point_mass.position.x * point_mass.mass;
+        center_y += (f64)point_mass.position.y * point_mass.mass;
+        center_vx += (f64)point_mass.velocity.x * point_mass.mass;
+        center_vy += (f64)point_mass.velocity.y * point_mass.mass;
+    }
+    center_x /= total_mass;
+    center_y /= total_mass;
+    center_vx /= total_mass;
+    center_vy /= total_mass;
+
+    for(i64 i = 0, j = 0; i < count; ++i) {
+        if(i == central) {
+            continue;
+        }
+
+        Point_Mass const& point_mass = point_masses[i];
+        qx[j] = (f64)point_mass.position.x - central_body.position.x;
+        qy[j] = (f64)point_mass.position.y - central_body.position.y;
+        vx[j] = (f64)point_mass.velocity.x - center_vx;
+        vy[j] = (f64)point_mass.velocity.y - center_vy;
+        masses[j] = point_mass.mass;
+        j += 1;
+    }
+
+    f64 const mu = gravitational_constant_f64 * central_mass;
+    f64 const half_timestep = 0.5 * timestep;
+    // Kick by the interactions between the non-central bodies.
+    auto kick = [&](f64 const dt) {
+        TRACE_ZONE("wisdom_holman_kick");
+        f64 const softening_length = settings.softening_length;
+        with_softening_kernel(settings.softening, [&](auto const kernel) {
+            using Kernel = decltype(kernel);
+            parallel_for(n, target_block_size, settings.thread_count, [&](i64 const begin, i64 const end) {
+                for(i64 i = begin; i < end; ++i) {
+                    f64 ax = 0.0;
+                    f64 ay = 0.0;
+                    for(i64 j = 0; j < n; ++j) {
+                        f64 const dx = qx[j] - qx[i];
+                        f64 const dy = qy[j] - qy[i];
+                        // Self contributes nothing since dx and dy are 0.
+                        f64 const factor = gravitational_constant_f64 * masses[j] * Kernel::get_force_factor(dx * dx + dy * dy, softening_length);
+                        ax += factor * dx;
+                        ay += factor * dy;
+                    }
+                    vx[i] += ax * dt;
+                    vy[i] += ay * dt;
+                }
+            });
+        });
+    };
+
+    // Drift of the heliocentric positions by the momentum of the central body.
+    auto jump = [&](f64 const dt) {
+        f64 px = 0.0;
+        f64 py = 0.0;
+        for(i64 i = 0; i < n; ++i) {
+            px += masses[i] * vx[i];
+            py += masses[i] * vy[i];
+        }
+
+        f64 const jump_x = px / central_mass * dt;
+        f64 const jump_y = py / central_mass * dt;
+        for(i64 i = 0; i < n; ++i) {
+            qx[i] += jump_x;
+            qy[i] += jump_y;
+        }
+    };
+
+    for(i64 step = 0; step < step_count; ++step) {
+        kick(half_timestep);
+        jump(half_timestep);
+        {
+            TRACE_ZONE("wisdom_holman_drift");
+            parallel_for(n, target_block_size, settings.thread_count, [&](i64 const begin, i64 const end) {
+                for(i64 i = begin; i < end; ++i) {
+                    kepler_drift_subdivided(mu, timestep, qx[i], qy[i], vx[i], vy[i], 0);
+                }
+            });
+        }
+        jump(half_timestep);
+        kick(half_timestep);
+        center_x += center_vx * timestep;
+        center_y += center_vy * timestep;
+    }
+
+    // Back to the inertial frame.
+    f64 weighted_qx = 0.0;
+    f64 weighted_qy = 0.0;
+    f64 momentum_x = 0.0;
+    f64 momentum_y = 0.0;
+    for(i64 i = 0; i < n; ++i) {
+        weighted_qx += masses[i] * qx[i];
+        weighted_qy += masses[i] * qy[i];
+        momentum_x += masses[i] * vx[i];
+        momentum_y += masses[i] * vy[i];
+    }
+
+    f64 const central_x = center_x - weighted_qx / total_mass;
+    f64 const central_y = center_y - weighted_qy / total_mass;
+    for(i64 i = 0, j = 0; i < count; ++i) {
+        Point_Mass& point_mass = point_masses[i];
+        if(i == central) {
+            point_mass.position = Vec2{(f32)central_x, (f32)central_y};
+            point_mass.velocity = Vec2{(f32)(center_vx - momentum_x / central_mass), (f32)(center_vy - momentum_y / central_mass)};
+            continue;
+        }
+
+        point_mass.position = Vec2{(f32)(qx[j] + central_x), (f32)(qy[j] + central_y)};
+        point_mass.velocity = Vec2{(f32)(vx[j] + center_vx), (f32)(vy[j] + center_vy)};
+        j += 1;
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <anton/slice.hpp>
+#include <build.hpp>
+#include <physics.hpp>
+
+struct Point_Mass;
+struct Arena_Allocator;
+
+// step_wisdom_holman
+// Advances the point masses by step_count substeps with the Wisdom-Holman map in
+// democratic heliocentric coordinates. The most massive body is the central body.
+// The Kepler motion around it is advanced exactly with the f and g functions,
+// the interactions between the other bodies are applied as kicks.
+// Suited for systems dominated by a single mass where it permits far larger timesteps.
+//
+// Parameters:
+// arena - scratch memory. Reset by the call.
+//
+void step_wisdom_holman(Physics_Settings const& settings, Arena_Allocator& arena, Slice<Point_Mass> point_masses, i64 step_count);
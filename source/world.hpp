@@ -4,6 +4,7 @@
 #include <anton/intrinsics.hpp>
 #include <anton/slice.hpp>
 #include <anton/typeid.hpp>
+#include <anton/utility.hpp>
 #include <build.hpp>
 #include <entity.hpp>
 
@@ -12,11 +13,14 @@ private:
     struct Container_Base {
     public:
         Container_Base(u64 id): id(id) {}
+        virtual ~Container_Base() = default;
 
         [[nodiscard]] u64 get_id() const {
             return id;
         }
 
+        virtual void reorder(Slice<Entity const> order) = 0;
+
     private:
         u64 id;
     };
@@ -49,6 +53,38 @@ private:
             return components[index];
         }
 
+        // The entities of order that have a component take the slots that their components
+        // occupy in ascending order. The remaining components stay in place.
+        void reorder(Slice<Entity const> const order) override {
+            Array<u8> occupied;
+            occupied.resize(components.size(), 0);
+            i64 const capacity = order.size() < components.size() ? order.size() : components.size();
+            Array<T> moved_components{reserve, capacity};
+            Array<Entity> moved_entities{reserve, capacity};
+            for(Entity const entity: order) {
+                if((i64)entity.id >= entity_index.size() || entity_index[entity.id] == -1) {
+                    continue;
+                }
+
+                i64 const index = entity_index[entity.id];
+                occupied[index] = 1;
+                moved_components.emplace_back(ANTON_MOV(components[index]));
+                moved_entities.emplace_back(entity);
+            }
+
+            i64 next = 0;
+            for(i64 index = 0; index < components.size(); ++index) {
+                if(!occupied[index]) {
+                    continue;
+                }
+
+                components[index] = ANTON_MOV(moved_components[next]);
+                entities[index] = moved_entities[next];
+                entity_index[moved_entities[next].id] = index;
+                next += 1;
+            }
+        }
+
     private:
         Array<T> components;
         Array<Entity> entities;
@@ -79,6 +115,17 @@ public:
         containers.emplace_back(container);
     }
 
+    template<typename T>
+    [[nodiscard]] bool has_type() const {
+        u64 const id = type_identifier<T>();
+        for(Container_Base const* container: containers) {
+            if(container->get_id() == id) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     template<typename T>
     [[nodiscard]] Slice<Entity> entities() {
         Container<T>* container = get_container<T>();
@@ -106,4 +153,15 @@ public:
         Container<T>* container = get_container<T>();
         return container->get(entity);
     }
+
+    // reorder_entities
+    // Rearranges the components of every type so that the entities of order appear in the
+    // same relative order in every container. Entity handles remain valid. References to
+    // the components obtained before the call may refer to components of other entities after it.
+    //
+    void reorder_entities(Slice<Entity const> const order) {
+        for(Container_Base* container: containers) {
+            container->reorder(order);
+        }
+    }
 };